@@ -32,8 +32,13 @@
 #include "AWS4Signature.h"
 
 #include <cbang/String.h>
-#include <cbang/openssl/Digest.h>
+#include <cbang/Exception.h>
 
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+#include <map>
+#include <mutex>
 #include <cctype>
 
 using namespace std;
@@ -41,6 +46,73 @@ using namespace cb;
 using namespace Buildbotics;
 
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static HMAC_CTX *HMAC_CTX_new() {
+  HMAC_CTX *ctx = new HMAC_CTX;
+  HMAC_CTX_init(ctx);
+  return ctx;
+}
+
+
+static void HMAC_CTX_free(HMAC_CTX *ctx) {
+  HMAC_CTX_cleanup(ctx);
+  delete ctx;
+}
+#endif
+
+
+namespace {
+  class HMACContext {
+    HMAC_CTX *ctx;
+    bool keyed;
+    std::string key;
+
+  public:
+    HMACContext() : ctx(HMAC_CTX_new()), keyed(false) {}
+    ~HMACContext() {HMAC_CTX_free(ctx);}
+
+    string sign(const string &key, const string &data) {
+      // Reuse the padded key state when signing with the same key
+      bool rekey = !keyed || key != this->key;
+
+      if (!HMAC_Init_ex(ctx, rekey ? key.data() : 0, key.size(),
+                        rekey ? EVP_sha256() : 0, 0))
+        THROW("HMAC init failed");
+
+      if (rekey) {
+        this->key = key;
+        keyed = true;
+      }
+
+      unsigned char md[EVP_MAX_MD_SIZE];
+      unsigned len = 0;
+
+      if (!HMAC_Update(ctx, (const unsigned char *)data.data(), data.size()) ||
+          !HMAC_Final(ctx, md, &len))
+        THROW("HMAC failed");
+
+      return string((const char *)md, len);
+    }
+  };
+
+
+  string signHMAC(const string &key, const string &data) {
+    static thread_local HMACContext ctx;
+    return ctx.sign(key, data);
+  }
+
+
+  // Derived keys only change once per day, keep only the current day's
+  struct KeyCache {
+    std::mutex lock;
+    string date;
+    std::map<string, string> keys;
+  };
+
+  KeyCache keyCache;
+}
+
+
 AWS4Signature::AWS4Signature(unsigned expires, uint64_t ts,
                              const string &service, const string &region) :
   expires(expires), ts(ts), service(service), region(region) {}
@@ -57,16 +129,43 @@ string AWS4Signature::getCredential(const string &id) const {
 
 
 string AWS4Signature::getKey(const string &secret) const {
-  string key = Digest::signHMAC("AWS4" + secret, getDate(), "sha256");
-  key = Digest::signHMAC(key, region, "sha256");
-  key = Digest::signHMAC(key, service, "sha256");
-  return Digest::signHMAC(key, "aws4_request", "sha256");
+  string date = getDate();
+
+  // Key the cache by a fingerprint rather than the secret itself
+  unsigned char md[SHA256_DIGEST_LENGTH];
+  SHA256((const unsigned char *)secret.data(), secret.size(), md);
+  string id = string((const char *)md, sizeof(md)) + "/" + getScope();
+
+  {
+    lock_guard<mutex> lock(keyCache.lock);
+
+    if (keyCache.date == date) {
+      auto it = keyCache.keys.find(id);
+      if (it != keyCache.keys.end()) return it->second;
+    }
+  }
+
+  string key = signHMAC("AWS4" + secret, date);
+  key = signHMAC(key, region);
+  key = signHMAC(key, service);
+  key = signHMAC(key, "aws4_request");
+
+  lock_guard<mutex> lock(keyCache.lock);
+
+  if (keyCache.date < date) {
+    keyCache.keys.clear();
+    keyCache.date = date;
+  }
+
+  if (keyCache.date == date) keyCache.keys[id] = key;
+
+  return key;
 }
 
 
 string AWS4Signature::getSignature(const string &secret,
                                    const string &data) const {
-  return String::hexEncode(Digest::signHMAC(getKey(secret), data, "sha256"));
+  return String::hexEncode(signHMAC(getKey(secret), data));
 }
 
 
@@ -34,6 +34,7 @@
 #include <cbang/Catch.h>
 
 #include <cbang/os/SystemUtilities.h>
+#include <cbang/os/SysError.h>
 
 #include <cbang/openssl/SSLContext.h>
 #include <cbang/time/Timer.h>
@@ -42,8 +43,13 @@
 #include <cbang/event/Event.h>
 #include <cbang/db/maria/EventDB.h>
 
+#include <event2/event.h>
+#include <event2/dns.h>
+
 #include <cstdlib>
+#include <csignal>
 #include <unistd.h>
+#include <sys/wait.h>
 
 using namespace Buildbotics;
 using namespace cb;
@@ -54,12 +60,28 @@ App::App() :
   ServerApplication("Buildbotics", &App::_hasFeature), base(true), dns(base),
   client(base, dns, new SSLContext), googleAuth(getOptions()),
   githubAuth(getOptions()), facebookAuth(getOptions()), server(*this),
-  userManager(*this), imageHost("https://images.buildbotics.com"),
+  userManager(*this), sessionCache(*this), dbPool(*this),
+  responseCache(*this), dbQueue(*this), thingViews(*this), downloads(*this),
+  counters(*this), signedURLs(*this), searchIndex(*this), eventBus(*this),
+  imageHost("https://images.buildbotics.com"),
   sessionCookieName("buildbotics.sid"), authTimeout(30 * Time::SEC_PER_DAY),
-  authGraceperiod(Time::SEC_PER_HOUR), dbHost("localhost"),
+  authGraceperiod(Time::SEC_PER_HOUR), sessionCacheSize(100000),
+  userCacheSize(100000), userCleanupPeriod(Time::SEC_PER_MIN),
+  apiRouter("trie"), responseCacheSize(64 * 1024 * 1024),
+  thingViewsFlushPeriod(10), downloadCacheSize(100000),
+  downloadCacheTTL(Time::SEC_PER_HOUR), countersFlushPeriod(5),
+  searchSyncPeriod(5), commitWindow(10), eventBusSize(1000), eventBusPeriod(1),
+  eventPollTimeout(30), compressionThreshold(1024), compressionLevel(6),
+  batchMax(20),
+  dbHost("localhost"),
   dbName("buildbotics"), dbPort(3306), dbTimeout(5),
-  dbMaintenancePeriod(Time::SEC_PER_HOUR), awsRegion("us-east-1"),
-  awsUploadExpires(Time::SEC_PER_HOUR * 2) {
+  dbMaintenancePeriod(Time::SEC_PER_HOUR), dbPoolMin(4), dbPoolMax(64),
+  dbPoolMaxWaiters(1024), dbPoolIdleTimeout(5 * Time::SEC_PER_MIN),
+  dbPoolCheckPeriod(30), dbQueueMax(10000), awsRegion("us-east-1"),
+  awsUploadExpires(Time::SEC_PER_HOUR * 2),
+  awsDownloadExpires(Time::SEC_PER_HOUR),
+  awsDownloadRenew(5 * Time::SEC_PER_MIN), workers(0), workerID(0),
+  supervisor(false) {
 
   options.pushCategory("Buildbotics Server");
   options.add("outbound-ip", "IP address for outbound connections.  Defaults "
@@ -72,6 +94,68 @@ App::App() :
   options.addTarget("auth-graceperiod", authGraceperiod,
                     "Time in seconds before expiration at which the server "
                     "automatically refreshes a user's authorization.");
+  options.addTarget("session-cache-size", sessionCacheSize, "Maximum number "
+                    "of verified sessions to cache in memory.");
+  options.addTarget("user-cache-size", userCacheSize, "Maximum number of "
+                    "active users to keep in memory.  The least recently used "
+                    "are dropped first.");
+  options.addTarget("user-cleanup-period", userCleanupPeriod, "Time in "
+                    "seconds between removals of expired users.");
+  options.addTarget("api-router", apiRouter, "API request dispatcher.  "
+                    "'trie' matches literal path segments first and only "
+                    "uses regular expressions for captures.  'set' matches "
+                    "all routes in one pass with an RE2::Set.  'regex' tries "
+                    "each route's regular expression in turn.");
+  options.addTarget("response-cache-size", responseCacheSize, "Maximum "
+                    "number of bytes of anonymous API responses to cache in "
+                    "memory.  Zero disables the cache.");
+  options.addTarget("thing-views-flush-period", thingViewsFlushPeriod,
+                    "Time in seconds between writes of collected thing views "
+                    "to the DB.");
+  options.addTarget("download-cache-size", downloadCacheSize, "Maximum "
+                    "number of file download redirects to cache in memory.  "
+                    "Zero disables the cache.");
+  options.addTarget("download-cache-ttl", downloadCacheTTL, "Time in seconds "
+                    "a cached file download redirect is used.");
+  options.addTarget("counters-flush-period", countersFlushPeriod, "Time in "
+                    "seconds between writes of collected counter changes, "
+                    "such as file downloads, to the DB.  Counter changes "
+                    "recorded by the DB are applied at the same rate.");
+  options.addTarget("file-store", fileStore, "Serve file downloads from this "
+                    "local directory rather than redirecting to S3.  It must "
+                    "hold the bucket's objects under their keys, as in the "
+                    "data directory of a local S3 compatible server.");
+  options.addTarget("search-sync-period", searchSyncPeriod, "Time in "
+                    "seconds between loads of thing and profile changes into "
+                    "the in-memory search index.  Local changes are loaded "
+                    "immediately.");
+  options.addTarget("commit-window", commitWindow, "Time in seconds a DB "
+                    "change may take to commit after its ID is assigned.  "
+                    "Search index syncs reread changes this recent and the "
+                    "event bus holds events after a gap in IDs this long, so "
+                    "ones committed out of ID order are not missed.");
+  options.addTarget("event-bus-size", eventBusSize, "Number of recent "
+                    "events kept in memory for long polling clients.");
+  options.addTarget("event-bus-period", eventBusPeriod, "Time in seconds "
+                    "between loads of new events for long polling clients.  "
+                    "Local changes are loaded immediately.");
+  options.addTarget("event-poll-timeout", eventPollTimeout, "Maximum time "
+                    "in seconds an event long poll waits before returning "
+                    "an empty list.");
+  options.addTarget("compression-threshold", compressionThreshold, "API "
+                    "responses of at least this many bytes are gzip "
+                    "compressed for clients that accept it.  Zero disables "
+                    "compression.");
+  options.addTarget("compression-level", compressionLevel, "gzip "
+                    "compression level for API responses, from 1, fastest, "
+                    "to 9, smallest.");
+  options.addTarget("batch-max", batchMax, "Maximum number of requests in "
+                    "one /api/batch call.");
+  options.addTarget("workers", workers, "Number of worker processes.  Each "
+                    "worker runs its own event loop, DB pool and user cache "
+                    "and accepts connections from the shared listening "
+                    "sockets.  If zero, requests are served by the main "
+                    "process.");
   options.add("http-root", "Serve /* files from this directory.");
   options.popCategory();
 
@@ -89,6 +173,22 @@ App::App() :
   options.addTarget("db-timeout", dbTimeout, "DB timeout");
   options.addTarget("db-maintenance-period", dbMaintenancePeriod, "The period, "
                     "in seconds, at which the DB maintenance routine is run");
+  options.addTarget("db-pool-min", dbPoolMin, "Number of DB connections to "
+                    "open at startup and keep open while idle");
+  options.addTarget("db-pool-max", dbPoolMax, "Maximum number of pooled DB "
+                    "connections");
+  options.addTarget("db-pool-max-waiters", dbPoolMaxWaiters, "Maximum number "
+                    "of requests which may wait for a DB connection before "
+                    "new requests are refused");
+  options.addTarget("db-pool-idle-timeout", dbPoolIdleTimeout, "Time in "
+                    "seconds after which idle DB connections above "
+                    "db-pool-min are closed");
+  options.addTarget("db-pool-check-period", dbPoolCheckPeriod, "Time in "
+                    "seconds after which idle DB connections are health "
+                    "checked");
+  options.addTarget("db-queue-max", dbQueueMax, "Maximum number of "
+                    "background DB writes, such as thing views, which may be "
+                    "queued before new ones are dropped");
   options.popCategory();
 
   options.pushCategory("Amazon Web Services");
@@ -99,6 +199,14 @@ App::App() :
   options.addTarget("aws-region", awsRegion, "AWS region code");
   options.addTarget("aws-upload-expires", awsUploadExpires,
                     "Lifetime in seconds of an AWS upload token");
+  options.addTarget("aws-download-expires", awsDownloadExpires, "Lifetime in "
+                    "seconds of a signed download URL for a private file");
+  options.addTarget("aws-download-renew", awsDownloadRenew, "Signed download "
+                    "URLs are reused until this many seconds before they "
+                    "expire");
+  options.addTarget("aws-s3-url", awsS3URL, "Base URL of the S3 bucket.  "
+                    "Defaults to https://<aws-bucket>.s3.amazonaws.com.  May "
+                    "point to a local S3 compatible server for testing.");
   options.popCategory();
 
   // Seed random number generator
@@ -115,9 +223,13 @@ bool App::_hasFeature(int feature) {
 }
 
 
-SmartPointer<MariaDB::EventDB> App::getDBConnection() {
-  // TODO Limit the total number of active connections
+string App::getAWSS3URL() const {
+  if (!awsS3URL.empty()) return awsS3URL;
+  return "https://" + awsBucket + ".s3.amazonaws.com";
+}
+
 
+SmartPointer<MariaDB::EventDB> App::getDBConnection() {
   SmartPointer<MariaDB::EventDB> db = new MariaDB::EventDB(base);
 
   // Configure
@@ -160,8 +272,49 @@ int App::init(int argc, char *argv[]) {
   if (dbUser.empty()) THROW("db-user not set");
   if (dbPass.empty()) THROW("db-pass not set");
 
-  // DB maintenance
-  base.newEvent(this, &App::maintenanceEvent)->add(dbMaintenancePeriod);
+  // Fork workers after the listening sockets are bound
+  if (workers) {
+    supervisor = true;
+    for (unsigned i = 0; i < workers && supervisor; i++) spawnWorker(i);
+    if (supervisor) return 0;
+  }
+
+  initWorker();
+
+  return 0;
+}
+
+
+void App::run() {
+  if (supervisor && !supervise()) return;
+
+  try {
+    base.dispatch();
+    LOG_INFO(1, "Clean exit");
+  } CATCH_ERROR;
+}
+
+
+void App::initWorker() {
+  // DB connection pool
+  dbPool.init();
+
+  // Expired user cleanup
+  userManager.init();
+
+  // Batched thing view and counter updates
+  thingViews.init();
+  counters.init();
+
+  // Full text search
+  searchIndex.init();
+
+  // Live events
+  eventBus.init();
+
+  // DB maintenance, only needed once
+  if (!workerID)
+    base.newEvent(this, &App::maintenanceEvent)->add(dbMaintenancePeriod);
 
   // Check lifeline
   if (getLifeline())
@@ -170,16 +323,75 @@ int App::init(int argc, char *argv[]) {
   // Handle exit signal
   base.newSignal(SIGINT, this, &App::signalEvent)->add();
   base.newSignal(SIGTERM, this, &App::signalEvent)->add();
+}
 
-  return 0;
+
+void App::spawnWorker(unsigned id) {
+  pid_t pid = fork();
+  if (pid < 0) THROW("Failed to fork worker " << id << ": " << SysError());
+
+  if (pid) {
+    children[pid] = id;
+    LOG_INFO(1, "Started worker " << id << " with PID " << pid);
+    return;
+  }
+
+  // In the worker
+  supervisor = false;
+  workerID = id;
+  children.clear();
+
+  // Recreate kernel event state and DNS sockets not safe to share
+  if (event_reinit(base.getBase()))
+    THROW("Failed to reinitialize event base in worker " << id);
+
+  evdns_base *dnsBase = dns.getDNSBase();
+  evdns_base_clear_nameservers_and_suspend(dnsBase);
+  evdns_base_resolv_conf_parse(dnsBase, DNS_OPTIONS_ALL, "/etc/resolv.conf");
+  evdns_base_resume(dnsBase);
 }
 
 
-void App::run() {
-  try {
-    base.dispatch();
-    LOG_INFO(1, "Clean exit");
-  } CATCH_ERROR;
+bool App::supervise() {
+  bool quitting = false;
+
+  while (!children.empty()) {
+    if (!quitting && shouldQuit()) {
+      quitting = true;
+      LOG_INFO(1, "Stopping " << children.size() << " workers");
+
+      for (auto it = children.begin(); it != children.end(); it++)
+        kill(it->first, SIGTERM);
+    }
+
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+
+    if (pid <= 0) {
+      Timer::sleep(0.25);
+      continue;
+    }
+
+    auto it = children.find(pid);
+    if (it == children.end()) continue;
+
+    unsigned id = it->second;
+    children.erase(it);
+    if (quitting) continue;
+
+    LOG_WARNING("Worker " << id << " exited with status " << status
+                << ", restarting");
+
+    Timer::sleep(1); // Avoid restarting a failing worker too quickly
+    spawnWorker(id);
+    if (!supervisor) {
+      initWorker();
+      return true;
+    }
+  }
+
+  LOG_INFO(1, "Clean exit");
+  return false;
 }
 
 
@@ -34,6 +34,17 @@
 
 #include "Server.h"
 #include "UserManager.h"
+#include "DBPool.h"
+#include "SessionCache.h"
+#include "ResponseCache.h"
+#include "SingleFlight.h"
+#include "DBQueue.h"
+#include "ThingViews.h"
+#include "Downloads.h"
+#include "Counters.h"
+#include "SignedURLs.h"
+#include "SearchIndex.h"
+#include "EventBus.h"
 
 #include <cbang/ServerApplication.h>
 #include <cbang/net/IPAddress.h>
@@ -48,6 +59,9 @@
 #include <cbang/event/Base.h>
 #include <cbang/event/Client.h>
 
+#include <map>
+#include <sys/types.h>
+
 namespace cb {
   namespace Event {class Event;}
   namespace MariaDB {class EventDB;}
@@ -66,12 +80,41 @@ namespace Buildbotics {
 
     Server server;
     UserManager userManager;
+    SessionCache sessionCache;
+    DBPool dbPool;
+    ResponseCache responseCache;
+    SingleFlight singleFlight;
+    DBQueue dbQueue;
+    ThingViews thingViews;
+    Downloads downloads;
+    Counters counters;
+    SignedURLs signedURLs;
+    SearchIndex searchIndex;
+    EventBus eventBus;
 
     cb::IPAddress outboundIP;
     std::string imageHost;
     std::string sessionCookieName;
     uint64_t authTimeout;
     uint64_t authGraceperiod;
+    unsigned sessionCacheSize;
+    unsigned userCacheSize;
+    double userCleanupPeriod;
+    std::string apiRouter;
+    uint64_t responseCacheSize;
+    double thingViewsFlushPeriod;
+    unsigned downloadCacheSize;
+    double downloadCacheTTL;
+    double countersFlushPeriod;
+    std::string fileStore;
+    double searchSyncPeriod;
+    unsigned commitWindow;
+    unsigned eventBusSize;
+    double eventBusPeriod;
+    double eventPollTimeout;
+    unsigned compressionThreshold;
+    int compressionLevel;
+    unsigned batchMax;
     cb::KeyPair key;
 
     std::string dbHost;
@@ -81,12 +124,26 @@ namespace Buildbotics {
     uint32_t dbPort;
     unsigned dbTimeout;
     double dbMaintenancePeriod;
+    unsigned dbPoolMin;
+    unsigned dbPoolMax;
+    unsigned dbPoolMaxWaiters;
+    double dbPoolIdleTimeout;
+    double dbPoolCheckPeriod;
+    unsigned dbQueueMax;
 
     std::string awsID;
     std::string awsSecret;
     std::string awsBucket;
     std::string awsRegion;
     uint32_t awsUploadExpires;
+    uint32_t awsDownloadExpires;
+    uint32_t awsDownloadRenew;
+    std::string awsS3URL;
+
+    unsigned workers;
+    unsigned workerID;
+    bool supervisor;
+    std::map<pid_t, unsigned> children;
 
     cb::SmartPointer<cb::MariaDB::EventDB> maintenanceDB;
 
@@ -105,14 +162,49 @@ namespace Buildbotics {
 
     Server &getServer() {return server;}
     UserManager &getUserManager() {return userManager;}
+    SessionCache &getSessionCache() {return sessionCache;}
+    DBPool &getDBPool() {return dbPool;}
+    ResponseCache &getResponseCache() {return responseCache;}
+    SingleFlight &getSingleFlight() {return singleFlight;}
+    DBQueue &getDBQueue() {return dbQueue;}
+    ThingViews &getThingViews() {return thingViews;}
+    Downloads &getDownloads() {return downloads;}
+    Counters &getCounters() {return counters;}
+    SignedURLs &getSignedURLs() {return signedURLs;}
+    SearchIndex &getSearchIndex() {return searchIndex;}
+    EventBus &getEventBus() {return eventBus;}
 
     cb::SmartPointer<cb::MariaDB::EventDB> getDBConnection();
+    unsigned getDBPoolMin() const {return dbPoolMin;}
+    unsigned getDBPoolMax() const {return dbPoolMax;}
+    unsigned getDBPoolMaxWaiters() const {return dbPoolMaxWaiters;}
+    double getDBPoolIdleTimeout() const {return dbPoolIdleTimeout;}
+    double getDBPoolCheckPeriod() const {return dbPoolCheckPeriod;}
+    unsigned getDBQueueMax() const {return dbQueueMax;}
 
     const cb::IPAddress &getOutboundIP() const {return outboundIP;}
     const std::string &getImageHost() const {return imageHost;}
     const std::string &getSessionCookieName() const {return sessionCookieName;}
     uint64_t getAuthTimeout() const {return authTimeout;}
     uint64_t getAuthGraceperiod() const {return authGraceperiod;}
+    unsigned getSessionCacheSize() const {return sessionCacheSize;}
+    unsigned getUserCacheSize() const {return userCacheSize;}
+    double getUserCleanupPeriod() const {return userCleanupPeriod;}
+    const std::string &getAPIRouter() const {return apiRouter;}
+    uint64_t getResponseCacheSize() const {return responseCacheSize;}
+    double getThingViewsFlushPeriod() const {return thingViewsFlushPeriod;}
+    unsigned getDownloadCacheSize() const {return downloadCacheSize;}
+    double getDownloadCacheTTL() const {return downloadCacheTTL;}
+    double getCountersFlushPeriod() const {return countersFlushPeriod;}
+    const std::string &getFileStore() const {return fileStore;}
+    double getSearchSyncPeriod() const {return searchSyncPeriod;}
+    unsigned getCommitWindow() const {return commitWindow;}
+    unsigned getEventBusSize() const {return eventBusSize;}
+    double getEventBusPeriod() const {return eventBusPeriod;}
+    double getEventPollTimeout() const {return eventPollTimeout;}
+    unsigned getCompressionThreshold() const {return compressionThreshold;}
+    int getCompressionLevel() const {return compressionLevel;}
+    unsigned getBatchMax() const {return batchMax;}
     const cb::KeyPair &getPrivateKey() const {return key;}
 
     const std::string &getAWSID() const {return awsID;}
@@ -120,11 +212,21 @@ namespace Buildbotics {
     const std::string &getAWSBucket() const {return awsBucket;}
     const std::string &getAWSRegion() const {return awsRegion;}
     uint32_t getAWSUploadExpires() const {return awsUploadExpires;}
+    uint32_t getAWSDownloadExpires() const {return awsDownloadExpires;}
+    uint32_t getAWSDownloadRenew() const {return awsDownloadRenew;}
+    std::string getAWSS3URL() const;
+
+    unsigned getWorkers() const {return workers;}
+    unsigned getWorkerID() const {return workerID;}
 
     // From cb::Application
     int init(int argc, char *argv[]);
     void run();
 
+    void initWorker();
+    void spawnWorker(unsigned id);
+    bool supervise();
+
     void dbMaintenanceCB(cb::MariaDB::EventDB::state_t state);
 
     void maintenanceEvent(cb::Event::Event &e, int signal, unsigned flags);
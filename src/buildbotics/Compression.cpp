@@ -0,0 +1,116 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "Compression.h"
+
+#include <cbang/String.h>
+#include <cbang/Exception.h>
+
+#include <event2/buffer.h>
+#include <zlib.h>
+
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+bool Compression::acceptsGzip(const string &acceptEncoding) {
+  vector<string> codings;
+  String::tokenize(acceptEncoding, codings, ",");
+
+  for (unsigned i = 0; i < codings.size(); i++) {
+    const string &coding = codings[i];
+    size_t semi = coding.find(';');
+    string name = String::toLower(String::trim(coding.substr(0, semi)));
+
+    if (name != "gzip" && name != "*") continue;
+
+    // A zero quality value means not acceptable
+    if (semi != string::npos) {
+      size_t q = coding.find("q=", semi);
+      if (q != string::npos && strtod(coding.c_str() + q + 2, 0) <= 0)
+        continue;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+
+void Compression::gzip(evbuffer *buffer, int level) {
+  if (!evbuffer_get_length(buffer)) return;
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+
+  // 16 + 15 window bits selects the gzip wrapper
+  if (deflateInit2(&z, level, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK) THROW("Failed to initialize gzip compression");
+
+  evbuffer *out = evbuffer_new();
+
+  // Each input chain is freed as soon as it is compressed, so the reply is
+  // never held both in full and compressed
+  while (evbuffer_get_length(buffer)) {
+    evbuffer_iovec in;
+    evbuffer_peek(buffer, -1, 0, &in, 1);
+
+    bool last = in.iov_len == evbuffer_get_length(buffer);
+    z.next_in = (Bytef *)in.iov_base;
+    z.avail_in = in.iov_len;
+
+    do {
+      evbuffer_iovec space;
+      evbuffer_reserve_space(out, 16 * 1024, &space, 1);
+
+      z.next_out = (Bytef *)space.iov_base;
+      z.avail_out = space.iov_len;
+      deflate(&z, last ? Z_FINISH : Z_NO_FLUSH);
+
+      space.iov_len -= z.avail_out;
+      evbuffer_commit_space(out, &space, 1);
+    } while (!z.avail_out);
+
+    evbuffer_drain(buffer, in.iov_len);
+  }
+
+  deflateEnd(&z);
+
+  evbuffer_add_buffer(buffer, out);
+  evbuffer_free(out);
+}
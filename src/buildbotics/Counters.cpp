@@ -0,0 +1,119 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "Counters.h"
+#include "App.h"
+
+#include <cbang/String.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/JSON.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+bool Counters::Key::operator<(const Key &o) const {
+  if (table != o.table) return table < o.table;
+  if (id != o.id) return id < o.id;
+  return column < o.column;
+}
+
+
+Counters::Counters(App &app) :
+  app(app), added(0), flushes(0), applies(0) {}
+
+
+void Counters::init() {
+  flushEvent = app.getEventBase().newEvent(this, &Counters::flushEventCB);
+  flushEvent->add(app.getCountersFlushPeriod());
+}
+
+
+void Counters::add(const string &table, uint32_t id, const string &column,
+                   int64_t delta) {
+  deltas[Key(table, id, column)] += delta;
+  added++;
+
+  // Bound memory use under heavy traffic
+  if (10 * BATCH_SIZE <= deltas.size()) flush();
+}
+
+
+void Counters::flush() {
+  DBQueue &queue = app.getDBQueue();
+  bool local = !deltas.empty();
+  deltas_t::iterator it = deltas.begin();
+
+  while (it != deltas.end()) {
+    SmartPointer<JSON::Value> dict = new JSON::Dict;
+    string rows;
+
+    for (unsigned i = 0; i < BATCH_SIZE && it != deltas.end(); i++, it++) {
+      string n = String(i);
+      dict->insert("t" + n, it->first.table);
+      dict->insert("c" + n, it->first.column);
+
+      if (i) rows += ", ";
+      rows += "(%(t" + n + ")S, " + String(it->first.id) + ", %(c" + n +
+        ")S, " + String(it->second) + ")";
+    }
+
+    queue.push("INSERT INTO counter_deltas (tbl, row_id, col, delta) "
+               "VALUES " + rows, dict);
+  }
+
+  deltas.clear();
+  if (local) flushes++;
+
+  // Triggers record deltas too, one worker applies them periodically
+  if (local || !app.getWorkerID()) {
+    queue.push("CALL ApplyCounterDeltas()");
+    applies++;
+  }
+}
+
+
+void Counters::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("pending", deltas.size());
+  writer.insert("added", added);
+  writer.insert("flushes", flushes);
+  writer.insert("applies", applies);
+  writer.endDict();
+}
+
+
+void Counters::flushEventCB(Event::Event &e, int signal, unsigned flags) {
+  e.add(app.getCountersFlushPeriod());
+  flush();
+}
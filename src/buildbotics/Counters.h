@@ -0,0 +1,93 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+
+#include <string>
+#include <map>
+#include <cstdint>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {class Writer;}
+}
+
+
+namespace Buildbotics {
+  class App;
+
+  // Sums counter changes in memory and writes them to the counter_deltas
+  // table in batches.  Each flush also applies all pending deltas, including
+  // those recorded by DB triggers, with ApplyCounterDeltas().
+  class Counters {
+    App &app;
+
+    struct Key {
+      std::string table;
+      uint32_t id;
+      std::string column;
+
+      Key(const std::string &table, uint32_t id, const std::string &column) :
+        table(table), id(id), column(column) {}
+
+      bool operator<(const Key &o) const;
+    };
+
+    typedef std::map<Key, int64_t> deltas_t;
+    deltas_t deltas;
+
+    cb::SmartPointer<cb::Event::Event> flushEvent;
+
+    // Stats
+    uint64_t added;
+    uint64_t flushes;
+    uint64_t applies;
+
+  public:
+    static const unsigned BATCH_SIZE = 1000;
+
+    Counters(App &app);
+
+    void init();
+
+    void add(const std::string &table, uint32_t id, const std::string &column,
+             int64_t delta = 1);
+    void flush();
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void flushEventCB(cb::Event::Event &e, int signal, unsigned flags);
+  };
+}
@@ -0,0 +1,143 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "Cursor.h"
+
+#include <cbang/String.h>
+#include <cbang/Exception.h>
+#include <cbang/event/HTTPStatus.h>
+
+#include <cctype>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+namespace {
+  const char *alphabet =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+
+  int decodeChar(char c) {
+    if ('A' <= c && c <= 'Z') return c - 'A';
+    if ('a' <= c && c <= 'z') return c - 'a' + 26;
+    if ('0' <= c && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+  }
+
+
+  void invalid() {
+    THROWX("Invalid cursor", Event::HTTPStatus::HTTP_BAD_REQUEST);
+  }
+
+
+  // Matches -?[0-9]+(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool isNumber(const string &s) {
+    unsigned i = 0;
+    unsigned n = s.length();
+
+    if (i < n && s[i] == '-') i++;
+    if (i == n || !isdigit(s[i])) return false;
+    while (i < n && isdigit(s[i])) i++;
+
+    if (i < n && s[i] == '.') {
+      if (++i == n || !isdigit(s[i])) return false;
+      while (i < n && isdigit(s[i])) i++;
+    }
+
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+      if (++i < n && (s[i] == '+' || s[i] == '-')) i++;
+      if (i == n || !isdigit(s[i])) return false;
+      while (i < n && isdigit(s[i])) i++;
+    }
+
+    return i == n;
+  }
+}
+
+
+string Cursor::encode(const string &kind, const string &key) {
+  string s = kind + ":" + key;
+  string token;
+  unsigned bits = 0;
+  unsigned value = 0;
+
+  for (unsigned i = 0; i < s.length(); i++) {
+    value = (value << 8) | (unsigned char)s[i];
+    bits += 8;
+
+    while (6 <= bits) {
+      bits -= 6;
+      token += alphabet[(value >> bits) & 63];
+    }
+  }
+
+  if (bits) token += alphabet[(value << (6 - bits)) & 63];
+
+  return token;
+}
+
+
+bool Cursor::decode(const string &kind, const string &token, unsigned count,
+                    vector<string> &parts) {
+  if (token.empty()) return false;
+
+  string s;
+  unsigned bits = 0;
+  unsigned value = 0;
+
+  for (unsigned i = 0; i < token.length(); i++) {
+    int c = decodeChar(token[i]);
+    if (c < 0) invalid();
+
+    value = (value << 6) | c;
+    bits += 6;
+
+    if (8 <= bits) {
+      bits -= 8;
+      s += (char)((value >> bits) & 0xff);
+    }
+  }
+
+  String::tokenize(s, parts, ":");
+
+  if (parts.size() != count + 1 || parts[0] != kind) invalid();
+
+  parts.erase(parts.begin());
+
+  for (unsigned i = 0; i < parts.size(); i++)
+    if (!isNumber(parts[i])) invalid();
+
+  return true;
+}
@@ -0,0 +1,51 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+namespace Buildbotics {
+  // Opaque pagination cursors.  A cursor holds the sort key of the last item
+  // on a page as ':' separated numbers, tagged with the kind of list it
+  // belongs to and URL safe base64 encoded.
+  class Cursor {
+  public:
+    static std::string encode(const std::string &kind, const std::string &key);
+
+    // Returns false if token is empty, throws HTTP_BAD_REQUEST if invalid
+    static bool decode(const std::string &kind, const std::string &token,
+                       unsigned count, std::vector<std::string> &parts);
+  };
+}
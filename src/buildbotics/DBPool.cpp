@@ -0,0 +1,247 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "DBPool.h"
+#include "App.h"
+
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+#include <cbang/time/Timer.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/Writer.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+DBPool::DBPool(App &app) :
+  app(app), active(0), checkingLastUsed(0), created(0), discarded(0),
+  waits(0), waitTime(0), maxWaitTime(0) {}
+
+
+void DBPool::init() {
+  if (!app.getDBPoolMax()) THROW("db-pool-max must be greater than zero");
+
+  Event::Base &base = app.getEventBase();
+  checkEvent = base.newEvent(this, &DBPool::checkEventCB);
+  dispatchEvent = base.newEvent(this, &DBPool::dispatchEventCB);
+
+  // Warm up
+  fill();
+  checkEvent->add(app.getDBPoolCheckPeriod());
+}
+
+
+SmartPointer<MariaDB::EventDB> DBPool::get() {
+  SmartPointer<MariaDB::EventDB> db;
+
+  if (!idle.empty()) {
+    db = idle.front().db;
+    idle.pop_front();
+
+  } else if (getSize() < app.getDBPoolMax()) {
+    db = app.getDBConnection();
+    created++;
+
+  } else return 0;
+
+  active++;
+
+  return db;
+}
+
+
+bool DBPool::wait(Waiter &waiter) {
+  if (app.getDBPoolMaxWaiters() <= waiters.size()) return false;
+
+  waiters.push_back(Wait(&waiter, Timer::now()));
+  schedule();
+
+  return true;
+}
+
+
+void DBPool::cancel(Waiter &waiter) {
+  for (waiters_t::iterator it = waiters.begin(); it != waiters.end(); it++)
+    if (it->waiter == &waiter) {
+      waiters.erase(it);
+      break;
+    }
+}
+
+
+void DBPool::release(const SmartPointer<MariaDB::EventDB> &db) {
+  if (!active) THROW("DB connection released twice");
+  active--;
+
+  idle.push_front(Connection(db, Timer::now()));
+  schedule();
+}
+
+
+void DBPool::discard(const SmartPointer<MariaDB::EventDB> &db) {
+  if (!active) THROW("DB connection released twice");
+  active--;
+  discarded++;
+
+  db->close();
+  schedule();
+}
+
+
+void DBPool::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("size", getSize());
+  writer.insert("active", getActive());
+  writer.insert("idle", getIdle());
+  writer.insert("waiters", getWaiters());
+  writer.insert("created", created);
+  writer.insert("discarded", discarded);
+  writer.insert("waits", waits);
+  writer.insert("wait_time", waitTime);
+  writer.insert("avg_wait_time", waits ? waitTime / waits : 0);
+  writer.insert("max_wait_time", maxWaitTime);
+  writer.endDict();
+}
+
+
+void DBPool::fill() {
+  while (getSize() < app.getDBPoolMin()) {
+    idle.push_back(Connection(app.getDBConnection(), Timer::now()));
+    created++;
+  }
+}
+
+
+void DBPool::insertIdle(const Connection &conn) {
+  // Keep most recently used first
+  idle_t::iterator it = idle.begin();
+  while (it != idle.end() && conn.lastUsed < it->lastUsed) it++;
+  idle.insert(it, conn);
+}
+
+
+void DBPool::check() {
+  if (!checking.isNull()) return;
+
+  double now = Timer::now();
+  double period = app.getDBPoolCheckPeriod();
+
+  // Health check an unused connection, one at a time, least recently used
+  // first.  Checks do not count as use so idle connections still time out.
+  for (auto it = idle.rbegin(); it != idle.rend(); it++)
+    if (it->lastUsed + period < now && it->lastChecked + period < now) {
+      checking = it->db;
+      checkingLastUsed = it->lastUsed;
+      idle.erase(--it.base());
+      checking->query(this, &DBPool::checkCB, "DO 1");
+      break;
+    }
+}
+
+
+void DBPool::schedule() {
+  if (!waiters.empty() && !dispatchEvent.isNull()) dispatchEvent->add(0);
+}
+
+
+void DBPool::checkCB(MariaDB::EventDB::state_t state) {
+  switch (state) {
+  case MariaDB::EventDB::EVENTDB_DONE: {
+    Connection conn(checking, checkingLastUsed);
+    conn.lastChecked = Timer::now();
+    insertIdle(conn);
+    checking.release();
+    schedule();
+    check();
+    break;
+  }
+
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    LOG_WARNING("DB pool health check failed: " << checking->getError());
+    discarded++;
+
+    // Cannot free the connection from inside its own callback
+    dead.push_back(checking);
+    checking.release();
+    fill();
+    schedule();
+    break;
+
+  default: break;
+  }
+}
+
+
+void DBPool::checkEventCB(Event::Event &e, int signal, unsigned flags) {
+  e.add(app.getDBPoolCheckPeriod());
+
+  for (auto it = dead.begin(); it != dead.end(); it++) (*it)->close();
+  dead.clear();
+
+  // Close connections which have been idle too long
+  double now = Timer::now();
+  while (!idle.empty() && app.getDBPoolMin() < getSize() &&
+         idle.back().lastUsed + app.getDBPoolIdleTimeout() < now) {
+    idle.back().db->close();
+    idle.pop_back();
+  }
+
+  check();
+  fill();
+}
+
+
+void DBPool::dispatchEventCB(Event::Event &e, int signal, unsigned flags) {
+  while (!waiters.empty()) {
+    SmartPointer<MariaDB::EventDB> db = get();
+    if (db.isNull()) break;
+
+    Wait wait = waiters.front();
+    waiters.pop_front();
+
+    double delta = Timer::now() - wait.start;
+    waits++;
+    waitTime += delta;
+    maxWaitTime = std::max(maxWaitTime, delta);
+
+    try {
+      wait.waiter->dbReady(db);
+      continue;
+    } CATCH_ERROR;
+
+    // The waiter did not take the connection, free its slot
+    discard(db);
+  }
+}
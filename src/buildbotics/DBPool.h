@@ -0,0 +1,127 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/db/maria/EventDB.h>
+
+#include <list>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {class Writer;}
+}
+
+
+namespace Buildbotics {
+  class App;
+
+  class DBPool {
+  public:
+    class Waiter {
+    public:
+      virtual ~Waiter() {}
+      // Owns db unless this throws, then the pool discards it
+      virtual void
+      dbReady(const cb::SmartPointer<cb::MariaDB::EventDB> &db) = 0;
+    };
+
+  protected:
+    App &app;
+
+    struct Connection {
+      cb::SmartPointer<cb::MariaDB::EventDB> db;
+      double lastUsed;
+      double lastChecked;
+
+      Connection(const cb::SmartPointer<cb::MariaDB::EventDB> &db,
+                 double lastUsed) :
+        db(db), lastUsed(lastUsed), lastChecked(lastUsed) {}
+    };
+
+    typedef std::list<Connection> idle_t;
+    idle_t idle; // Most recently used first
+
+    struct Wait {
+      Waiter *waiter;
+      double start;
+
+      Wait(Waiter *waiter, double start) : waiter(waiter), start(start) {}
+    };
+
+    typedef std::list<Wait> waiters_t;
+    waiters_t waiters;
+
+    unsigned active;
+    cb::SmartPointer<cb::MariaDB::EventDB> checking;
+    double checkingLastUsed;
+    std::list<cb::SmartPointer<cb::MariaDB::EventDB> > dead;
+
+    cb::SmartPointer<cb::Event::Event> checkEvent;
+    cb::SmartPointer<cb::Event::Event> dispatchEvent;
+
+    // Stats
+    uint64_t created;
+    uint64_t discarded;
+    uint64_t waits;
+    double waitTime;
+    double maxWaitTime;
+
+  public:
+    DBPool(App &app);
+
+    unsigned getSize() const {return active + idle.size() + !checking.isNull();}
+    unsigned getActive() const {return active;}
+    unsigned getIdle() const {return idle.size();}
+    unsigned getWaiters() const {return waiters.size();}
+
+    void init();
+
+    cb::SmartPointer<cb::MariaDB::EventDB> get();
+    bool wait(Waiter &waiter);
+    void cancel(Waiter &waiter);
+    void release(const cb::SmartPointer<cb::MariaDB::EventDB> &db);
+    void discard(const cb::SmartPointer<cb::MariaDB::EventDB> &db);
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void fill();
+    void insertIdle(const Connection &conn);
+    void check();
+    void schedule();
+
+    void checkCB(cb::MariaDB::EventDB::state_t state);
+    void checkEventCB(cb::Event::Event &e, int signal, unsigned flags);
+    void dispatchEventCB(cb::Event::Event &e, int signal, unsigned flags);
+  };
+}
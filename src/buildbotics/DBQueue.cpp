@@ -0,0 +1,118 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "DBQueue.h"
+#include "App.h"
+
+#include <cbang/log/Logger.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/Writer.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+DBQueue::DBQueue(App &app) :
+  app(app), running(false), completed(0), failed(0), dropped(0) {}
+
+
+void DBQueue::push(const string &sql, const SmartPointer<JSON::Value> &dict) {
+  if (app.getDBQueueMax() <= queue.size()) {
+    LOG_WARNING("DB queue full, dropping: " << sql);
+    dropped++;
+    return;
+  }
+
+  queue.push_back(Query(sql, dict));
+  schedule();
+}
+
+
+void DBQueue::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("size", queue.size());
+  writer.insert("completed", completed);
+  writer.insert("failed", failed);
+  writer.insert("dropped", dropped);
+  writer.endDict();
+}
+
+
+void DBQueue::schedule() {
+  if (running || queue.empty()) return;
+
+  if (nextEvent.isNull())
+    nextEvent = app.getEventBase().newEvent(this, &DBQueue::nextEventCB);
+
+  nextEvent->add(0);
+}
+
+
+void DBQueue::queryCB(MariaDB::EventDB::state_t state) {
+  switch (state) {
+  case MariaDB::EventDB::EVENTDB_DONE:
+    completed++;
+    queue.pop_front();
+    running = false;
+    schedule();
+    break;
+
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    LOG_WARNING("DB queue: " << db->getError() << ": " << queue.front().sql);
+    failed++;
+    queue.pop_front();
+    running = false;
+
+    // Cannot free the connection from inside its own callback
+    dead = db;
+    db.release();
+    schedule();
+    break;
+
+  default: break;
+  }
+}
+
+
+void DBQueue::nextEventCB(Event::Event &e, int signal, unsigned flags) {
+  if (!dead.isNull()) {
+    dead->close();
+    dead.release();
+  }
+
+  if (running || queue.empty()) return;
+
+  if (db.isNull()) db = app.getDBConnection();
+
+  running = true;
+  db->query(this, &DBQueue::queryCB, queue.front().sql, queue.front().dict);
+}
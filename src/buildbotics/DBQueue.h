@@ -0,0 +1,95 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/db/maria/EventDB.h>
+
+#include <string>
+#include <list>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {
+    class Writer;
+    class Value;
+  }
+}
+
+
+namespace Buildbotics {
+  class App;
+
+  // Runs queries whose results are not needed one at a time on a
+  // background connection
+  class DBQueue {
+    App &app;
+
+    struct Query {
+      std::string sql;
+      cb::SmartPointer<cb::JSON::Value> dict;
+
+      Query(const std::string &sql,
+            const cb::SmartPointer<cb::JSON::Value> &dict) :
+        sql(sql), dict(dict) {}
+    };
+
+    typedef std::list<Query> queue_t;
+    queue_t queue;
+
+    cb::SmartPointer<cb::MariaDB::EventDB> db;
+    cb::SmartPointer<cb::MariaDB::EventDB> dead;
+    cb::SmartPointer<cb::Event::Event> nextEvent;
+    bool running;
+
+    // Stats
+    uint64_t completed;
+    uint64_t failed;
+    uint64_t dropped;
+
+  public:
+    DBQueue(App &app);
+
+    unsigned getSize() const {return queue.size();}
+
+    void push(const std::string &sql,
+              const cb::SmartPointer<cb::JSON::Value> &dict = 0);
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void schedule();
+
+    void queryCB(cb::MariaDB::EventDB::state_t state);
+    void nextEventCB(cb::Event::Event &e, int signal, unsigned flags);
+  };
+}
@@ -0,0 +1,116 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "Downloads.h"
+#include "App.h"
+
+#include <cbang/time/Timer.h>
+#include <cbang/json/Writer.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+Downloads::Downloads(App &app) :
+  app(app), hits(0), misses(0), counted(0) {}
+
+
+string Downloads::key(const string &profile, const string &thing,
+                      const string &file, const string &size) {
+  // Names cannot contain '/', a prefix ends at any component
+  string key = profile + "/";
+  if (!thing.empty()) key += thing + "/";
+  if (!file.empty()) key += file + "/" + size;
+  return key;
+}
+
+
+const Downloads::Entry *Downloads::lookup(const string &key) {
+  entries_t::iterator it = entries.find(key);
+
+  if (it != entries.end()) {
+    if (Timer::now() < it->second.expires) {
+      hits++;
+      return &it->second;
+    }
+
+    remove(it);
+  }
+
+  misses++;
+  return 0;
+}
+
+
+void Downloads::insert(const string &key, const Entry &entry) {
+  unsigned maxSize = app.getDownloadCacheSize();
+  if (!maxSize) return;
+
+  entries_t::iterator it = entries.find(key);
+  if (it != entries.end()) remove(it);
+
+  while (maxSize <= entries.size()) remove(entries.find(order.front()));
+
+  Entry &e = entries[key] = entry;
+  e.expires = Timer::now() + app.getDownloadCacheTTL();
+  e.order = order.insert(order.end(), key);
+}
+
+
+void Downloads::invalidate(const string &prefix) {
+  entries_t::iterator it = entries.lower_bound(prefix);
+
+  while (it != entries.end() && !it->first.compare(0, prefix.size(), prefix))
+    remove(it++);
+}
+
+
+void Downloads::count(uint32_t fileID) {
+  app.getCounters().add("files", fileID, "downloads");
+  counted++;
+}
+
+
+void Downloads::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("size", entries.size());
+  writer.insert("hits", hits);
+  writer.insert("misses", misses);
+  writer.insert("counted", counted);
+  writer.endDict();
+}
+
+
+void Downloads::remove(entries_t::iterator it) {
+  order.erase(it->second.order);
+  entries.erase(it);
+}
@@ -0,0 +1,280 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "EventBus.h"
+#include "App.h"
+#include "Transaction.h"
+
+#include <cbang/String.h>
+#include <cbang/Catch.h>
+#include <cbang/log/Logger.h>
+#include <cbang/time/Time.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/Writer.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+bool EventBus::Filter::matches(const Entry &e) const {
+  if (e.id <= after) return false;
+  if (!subject.empty() && e.subject != subject) return false;
+  if (!actions.empty() &&
+      std::find(actions.begin(), actions.end(), e.action) == actions.end())
+    return false;
+
+  return true;
+}
+
+
+EventBus::EventBus(App &app) :
+  app(app), lastID(0), ready(false), syncing(false), pending(false),
+  syncs(0), delivered(0), timeouts(0) {}
+
+
+void EventBus::init() {
+  syncEvent = app.getEventBase().newEvent(this, &EventBus::syncEventCB);
+  syncEvent->add(0);
+
+  app.getEventBase().newEvent(this, &EventBus::sweepEventCB)->add(1);
+}
+
+
+void EventBus::sync() {
+  if (syncing) {
+    pending = true;
+    return;
+  }
+
+  if (!dead.isNull()) {
+    dead->close();
+    dead.release();
+  }
+
+  if (db.isNull()) db = app.getDBConnection();
+
+  // On startup fill the buffer with the most recent events
+  string after = ready ? String(lastID) : string("null");
+
+  pending = false;
+  syncing = true;
+  loaded.clear();
+  db->query(this, &EventBus::queryCB, "CALL GetEventsAfter(" + after + ", " +
+            String(app.getEventBusSize()) + ")");
+}
+
+
+void EventBus::find(const Filter &filter, entries_t &entries) const {
+  // Skip to the first event after the filter's
+  Entry key;
+  key.id = filter.after;
+  auto it = upper_bound(events.begin(), events.end(), key,
+                        [] (const Entry &a, const Entry &b) {
+                          return a.id < b.id;
+                        });
+
+  for (; it != events.end() && entries.size() < filter.limit; it++)
+    if (filter.matches(*it)) entries.push_back(&*it);
+}
+
+
+void EventBus::wait(Transaction &tx, const Filter &filter, double timeout) {
+  Waiter &waiter = waiters[&tx];
+  waiter.filter = filter;
+  waiter.expires = Time::now() + (uint64_t)std::max(0.0, timeout);
+}
+
+
+void EventBus::leave(Transaction &tx) {waiters.erase(&tx);}
+
+
+void EventBus::write(JSON::Writer &writer, const entries_t &entries) {
+  writer.beginList();
+
+  for (unsigned i = 0; i < entries.size(); i++) {
+    const Entry &e = *entries[i];
+
+    writer.beginAppend();
+    writer.beginDict();
+    writer.insert("id", e.id);
+    writer.insert("ts", e.ts);
+    writer.insert("subject", e.subject);
+    writer.insert("action", e.action);
+    writer.insert("object_type", e.objectType);
+    writer.insert("path", e.path);
+    writer.endDict();
+  }
+
+  writer.endList();
+}
+
+
+void EventBus::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("ready", ready);
+  writer.insert("last_id", lastID);
+  writer.insert("events", events.size());
+  writer.insert("held", held.size());
+  writer.insert("waiters", waiters.size());
+  writer.insert("syncs", syncs);
+  writer.insert("delivered", delivered);
+  writer.insert("timeouts", timeouts);
+  writer.endDict();
+}
+
+
+void EventBus::notify() {
+  vector<Transaction *> done;
+  vector<entries_t> found;
+
+  for (auto it = waiters.begin(); it != waiters.end(); it++) {
+    entries_t entries;
+    find(it->second.filter, entries);
+    if (entries.empty()) continue;
+
+    done.push_back(it->first);
+    found.push_back(entries);
+  }
+
+  // Waiters may be freed as they reply
+  for (unsigned i = 0; i < done.size(); i++) waiters.erase(done[i]);
+
+  for (unsigned i = 0; i < done.size(); i++)
+    try {
+      done[i]->replyEvents(found[i]);
+      delivered++;
+    } CATCH_ERROR;
+}
+
+
+void EventBus::sweep() {
+  uint64_t now = Time::now();
+  vector<Transaction *> expired;
+
+  for (auto it = waiters.begin(); it != waiters.end(); it++)
+    if (it->second.expires <= now) expired.push_back(it->first);
+
+  for (unsigned i = 0; i < expired.size(); i++) waiters.erase(expired[i]);
+
+  for (unsigned i = 0; i < expired.size(); i++)
+    try {
+      expired[i]->replyEvents(entries_t());
+      timeouts++;
+    } CATCH_ERROR;
+}
+
+
+void EventBus::queryCB(MariaDB::EventDB::state_t state) {
+  switch (state) {
+  case MariaDB::EventDB::EVENTDB_ROW: {
+    Entry e;
+    e.id = db->getU32(0);
+    e.ts = db->getString(1);
+    e.subject = db->getString(2);
+    e.action = db->getString(3);
+    e.objectType = db->getString(4);
+    if (!db->getNull(5)) e.path = db->getString(5);
+    loaded.push_back(e);
+    break;
+  }
+
+  case MariaDB::EventDB::EVENTDB_DONE: {
+    uint64_t now = Time::now();
+    uint32_t startID = lastID;
+    bool full = loaded.size() == app.getEventBusSize();
+
+    for (unsigned i = 0; i < loaded.size(); i++)
+      if (lastID < loaded[i].id && !held.count(loaded[i].id)) {
+        Held &h = held[loaded[i].id];
+        h.entry = loaded[i];
+        h.seen = now;
+      }
+
+    loaded.clear();
+
+    // IDs are assigned at insert but rows are read after commit, so an
+    // event may show up after a higher ID.  The high-water mark only moves
+    // past a gap once it fills or has been open for commit-window seconds.
+    while (!held.empty()) {
+      auto it = held.begin();
+
+      if (ready && it->first != lastID + 1 &&
+          now < it->second.seen + app.getCommitWindow()) break;
+
+      // Events without a path only fill the gap
+      if (!it->second.entry.path.empty()) events.push_back(it->second.entry);
+      lastID = it->first;
+      held.erase(it);
+    }
+
+    while (app.getEventBusSize() < events.size()) events.pop_front();
+
+    // A full batch may have more events behind it, unless stuck on a gap
+    if (ready && full && lastID != startID) pending = true;
+
+    ready = true;
+    syncing = false;
+    syncs++;
+
+    notify();
+    if (pending) syncEvent->add(0);
+    break;
+  }
+
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    LOG_WARNING("Event bus sync failed: " << db->getError());
+    loaded.clear();
+    syncing = false;
+
+    // Cannot free the connection from inside its own callback
+    dead = db;
+    db.release();
+    break;
+
+  default: break;
+  }
+}
+
+
+void EventBus::syncEventCB(Event::Event &e, int signal, unsigned flags) {
+  e.add(app.getEventBusPeriod());
+  sync();
+}
+
+
+void EventBus::sweepEventCB(Event::Event &e, int signal, unsigned flags) {
+  e.add(1);
+  sweep();
+}
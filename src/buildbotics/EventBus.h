@@ -0,0 +1,138 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+#include <cbang/db/maria/EventDB.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstdint>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {class Writer;}
+}
+
+
+namespace Buildbotics {
+  class App;
+  class Transaction;
+
+  // Recent events held in memory for long polling clients.  New events are
+  // loaded with one DB query per period, or immediately after local writes,
+  // and handed to every waiting request they match.
+  class EventBus {
+    App &app;
+
+  public:
+    struct Entry {
+      uint32_t id;
+      std::string ts;
+      std::string subject;
+      std::string action;
+      std::string objectType;
+      std::string path;
+    };
+
+    struct Filter {
+      uint32_t after;
+      std::string subject;
+      std::vector<std::string> actions;
+      unsigned limit;
+
+      bool matches(const Entry &e) const;
+    };
+
+    typedef std::vector<const Entry *> entries_t;
+
+  protected:
+    std::deque<Entry> events; // Oldest first
+    std::vector<Entry> loaded;
+
+    // Events after a gap in IDs, held until it fills or commit-window passes
+    struct Held {
+      Entry entry;
+      uint64_t seen;
+    };
+
+    std::map<uint32_t, Held> held;
+    uint32_t lastID;
+    bool ready;
+    bool syncing;
+    bool pending;
+
+    struct Waiter {
+      Filter filter;
+      uint64_t expires;
+    };
+
+    typedef std::map<Transaction *, Waiter> waiters_t;
+    waiters_t waiters;
+
+    cb::SmartPointer<cb::MariaDB::EventDB> db;
+    cb::SmartPointer<cb::MariaDB::EventDB> dead;
+    cb::SmartPointer<cb::Event::Event> syncEvent;
+
+    // Stats
+    uint64_t syncs;
+    uint64_t delivered;
+    uint64_t timeouts;
+
+  public:
+    EventBus(App &app);
+
+    void init();
+    void sync();
+
+    bool isReady() const {return ready;}
+    uint32_t getLastID() const {return lastID;}
+
+    void find(const Filter &filter, entries_t &entries) const;
+    void wait(Transaction &tx, const Filter &filter, double timeout);
+    void leave(Transaction &tx);
+
+    static void write(cb::JSON::Writer &writer, const entries_t &entries);
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void notify();
+    void sweep();
+
+    void queryCB(cb::MariaDB::EventDB::state_t state);
+    void syncEventCB(cb::Event::Event &e, int signal, unsigned flags);
+    void sweepEventCB(cb::Event::Event &e, int signal, unsigned flags);
+  };
+}
@@ -0,0 +1,125 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "ResponseCache.h"
+#include "App.h"
+
+#include <cbang/String.h>
+#include <cbang/time/Timer.h>
+#include <cbang/openssl/Digest.h>
+#include <cbang/json/Writer.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+ResponseCache::ResponseCache(App &app) :
+  app(app), bytes(0), hits(0), misses(0), invalidated(0) {}
+
+
+const ResponseCache::Entry *ResponseCache::lookup(const string &key) {
+  entries_t::iterator it = entries.find(key);
+
+  if (it != entries.end()) {
+    if (Timer::now() < it->second.expires) {
+      hits++;
+      return &it->second;
+    }
+
+    remove(it);
+  }
+
+  misses++;
+  return 0;
+}
+
+
+void ResponseCache::insert(const string &key, const string &data,
+                           const string &etag, double ttl,
+                           const string &cursor) {
+  uint64_t maxBytes = app.getResponseCacheSize();
+  if (maxBytes < data.size()) return;
+
+  entries_t::iterator it = entries.find(key);
+  if (it != entries.end()) remove(it);
+
+  // Enforce size limit, oldest first
+  while (!order.empty() && maxBytes < bytes + data.size())
+    remove(entries.find(order.front()));
+
+  Entry &entry = entries[key];
+  entry.data = data;
+  entry.etag = etag;
+  entry.cursor = cursor;
+  entry.expires = Timer::now() + ttl;
+  entry.order = order.insert(order.end(), key);
+  bytes += data.size();
+}
+
+
+void ResponseCache::invalidate(const string &prefix) {
+  entries_t::iterator it = entries.lower_bound(prefix);
+
+  while (it != entries.end() && !it->first.compare(0, prefix.size(), prefix)) {
+    remove(it++);
+    invalidated++;
+  }
+}
+
+
+string ResponseCache::makeETag(const string &data) {
+  return "\"" + String::hexEncode(Digest::hash(data, "sha256")).substr(0, 32) +
+    "\"";
+}
+
+
+string ResponseCache::gzipETag(const string &etag) {
+  return etag.substr(0, etag.length() - 1) + "-gz\"";
+}
+
+
+void ResponseCache::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("size", entries.size());
+  writer.insert("bytes", bytes);
+  writer.insert("hits", hits);
+  writer.insert("misses", misses);
+  writer.insert("invalidated", invalidated);
+  writer.endDict();
+}
+
+
+void ResponseCache::remove(entries_t::iterator it) {
+  bytes -= it->second.data.size();
+  order.erase(it->second.order);
+  entries.erase(it);
+}
@@ -0,0 +1,89 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <list>
+#include <cstdint>
+
+namespace cb {namespace JSON {class Writer;}}
+
+
+namespace Buildbotics {
+  class App;
+
+  class ResponseCache {
+  public:
+    struct Entry {
+      std::string data;
+      std::string etag;
+      std::string cursor; // Next page
+      double expires;
+      std::list<std::string>::iterator order;
+    };
+
+  protected:
+    App &app;
+
+    typedef std::list<std::string> order_t;
+    order_t order; // Oldest first
+
+    // Ordered so related keys can be invalidated by prefix
+    typedef std::map<std::string, Entry> entries_t;
+    entries_t entries;
+
+    uint64_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidated;
+
+  public:
+    ResponseCache(App &app);
+
+    const Entry *lookup(const std::string &key);
+    void insert(const std::string &key, const std::string &data,
+                const std::string &etag, double ttl,
+                const std::string &cursor = std::string());
+    void invalidate(const std::string &prefix);
+
+    // Strong ETag from a hash of the response body
+    static std::string makeETag(const std::string &data);
+    // The ETag of the same body sent gzip encoded
+    static std::string gzipETag(const std::string &etag);
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void remove(entries_t::iterator it);
+  };
+}
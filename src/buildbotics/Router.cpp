@@ -0,0 +1,239 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "Router.h"
+#include "Transaction.h"
+
+#include <cbang/Exception.h>
+#include <cbang/json/Dict.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+Router::Router() {}
+Router::~Router() {}
+
+
+void Router::addCapture(const string &name, const string &pattern) {
+  patterns[name] = pattern;
+}
+
+
+void Router::add(unsigned methods, const string &path, member_t member) {
+  vector<string> segments;
+  split(path, segments);
+
+  Node *node = &root;
+  for (unsigned i = 0; i < segments.size(); i++) {
+    const string &seg = segments[i];
+
+    if (2 < seg.size() && seg[0] == '{' && seg[seg.size() - 1] == '}') {
+      string name = seg.substr(1, seg.size() - 2);
+
+      Capture *capture = 0;
+      for (unsigned j = 0; j < node->captures.size(); j++)
+        if (node->captures[j].name == name) capture = &node->captures[j];
+
+      if (!capture) {
+        node->captures.push_back(Capture());
+        capture = &node->captures.back();
+        capture->name = name;
+        capture->re = new RE2(getPattern(name));
+        capture->node = new Node;
+
+        if (!capture->re->ok())
+          THROW("Invalid pattern for route capture '" << name << "': "
+                << capture->re->error());
+      }
+
+      node = capture->node.get();
+
+    } else {
+      SmartPointer<Node> &child = node->literals[seg];
+      if (child.isNull()) child = new Node;
+      node = child.get();
+    }
+  }
+
+  node->handlers.push_back(Handler(methods, member));
+  routes.push_back(Route(methods, member, new RE2(toRegex(path))));
+}
+
+
+void Router::compileSet() {
+  set = new RE2::Set(RE2::DefaultOptions, RE2::ANCHOR_BOTH);
+
+  for (unsigned i = 0; i < routes.size(); i++) {
+    string error;
+    if (set->Add(routes[i].re->pattern(), &error) != (int)i)
+      THROW("Failed to add route pattern '" << routes[i].re->pattern()
+            << "' to set: " << error);
+  }
+
+  if (!set->Compile()) THROW("Failed to compile route set");
+}
+
+
+string Router::toRegex(const string &path) const {
+  vector<string> segments;
+  split(path, segments);
+
+  string re;
+  for (unsigned i = 0; i < segments.size(); i++) {
+    const string &seg = segments[i];
+    re += "/";
+
+    if (2 < seg.size() && seg[0] == '{' && seg[seg.size() - 1] == '}') {
+      string name = seg.substr(1, seg.size() - 2);
+      re += "(?P<" + name + ">" + getPattern(name) + ")";
+
+    } else re += RE2::QuoteMeta(seg);
+  }
+
+  return re;
+}
+
+
+bool Router::dispatch(Transaction &tx) const {
+  vector<string> segments;
+  if (set.isNull()) split(tx.getURI().getPath(), segments);
+
+  args_t args;
+  member_t member = 0;
+
+  if (set.isNull()) {
+    const Handler *handler = match(root, segments, 0, tx.getMethod(), args);
+    if (handler) member = handler->member;
+
+  } else {
+    const Route *route = matchSet(tx.getURI().getPath(), tx.getMethod(), args);
+    if (route) member = route->member;
+  }
+
+  if (!member) return false;
+
+  for (unsigned i = 0; i < args.size(); i++)
+    tx.getArgs()->insert(args[i].first, args[i].second);
+
+  return (tx.*member)();
+}
+
+
+void Router::split(const string &path, vector<string> &segments) {
+  if (path.empty() || path[0] != '/') return;
+
+  // Empty segments are kept so e.g. a trailing slash never matches
+  string::size_type start = 1;
+  while (true) {
+    string::size_type end = path.find('/', start);
+    segments.push_back(path.substr(start, end - start));
+    if (end == string::npos) break;
+    start = end + 1;
+  }
+}
+
+
+const string &Router::getPattern(const string &name) const {
+  auto it = patterns.find(name);
+  if (it == patterns.end()) THROW("Unknown route capture '" << name << "'");
+  return it->second;
+}
+
+
+const Router::Handler *Router::match(const Node &node,
+                                     const vector<string> &segments,
+                                     unsigned i, unsigned method,
+                                     args_t &args) const {
+  if (i == segments.size()) {
+    for (unsigned j = 0; j < node.handlers.size(); j++)
+      if (node.handlers[j].methods & method) return &node.handlers[j];
+
+    return 0;
+  }
+
+  const string &seg = segments[i];
+
+  // Literal segments take precedence over captures
+  auto it = node.literals.find(seg);
+  if (it != node.literals.end()) {
+    const Handler *handler = match(*it->second, segments, i + 1, method, args);
+    if (handler) return handler;
+  }
+
+  for (unsigned j = 0; j < node.captures.size(); j++) {
+    const Capture &capture = node.captures[j];
+    if (!RE2::FullMatch(seg, *capture.re)) continue;
+
+    args.push_back(make_pair(capture.name, seg));
+    const Handler *handler =
+      match(*capture.node, segments, i + 1, method, args);
+    if (handler) return handler;
+    args.pop_back();
+  }
+
+  return 0;
+}
+
+
+const Router::Route *Router::matchSet(const string &path, unsigned method,
+                                      args_t &args) const {
+  vector<int> matches;
+  if (!set->Match(path, &matches)) return 0;
+
+  // Earlier routes take precedence, as with per-route matching
+  sort(matches.begin(), matches.end());
+
+  const Route *route = 0;
+  for (unsigned i = 0; i < matches.size() && !route; i++)
+    if (routes[matches[i]].methods & method) route = &routes[matches[i]];
+
+  if (!route) return 0;
+
+  // Extract named captures from the one matching route
+  const RE2 &re = *route->re;
+  int n = re.NumberOfCapturingGroups();
+  vector<re2::StringPiece> groups(n + 1);
+
+  if (!re.Match(path, 0, path.size(), RE2::ANCHOR_BOTH, &groups[0], n + 1))
+    return 0;
+
+  const map<string, int> &names = re.NamedCapturingGroups();
+  for (auto it = names.begin(); it != names.end(); it++) {
+    const re2::StringPiece &group = groups[it->second];
+    if (group.data()) args.push_back(make_pair(it->first, group.as_string()));
+  }
+
+  return route;
+}
@@ -0,0 +1,114 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+
+#include <re2/re2.h>
+#include <re2/set.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace Buildbotics {
+  class Transaction;
+
+  class Router {
+  public:
+    typedef bool (Transaction::*member_t)();
+
+  protected:
+    struct Node;
+
+    struct Handler {
+      unsigned methods;
+      member_t member;
+
+      Handler(unsigned methods, member_t member) :
+        methods(methods), member(member) {}
+    };
+
+    struct Capture {
+      std::string name;
+      cb::SmartPointer<re2::RE2> re;
+      cb::SmartPointer<Node> node;
+    };
+
+    struct Node {
+      std::map<std::string, cb::SmartPointer<Node> > literals;
+      std::vector<Capture> captures;
+      std::vector<Handler> handlers;
+    };
+
+    struct Route {
+      unsigned methods;
+      member_t member;
+      cb::SmartPointer<re2::RE2> re;
+
+      Route(unsigned methods, member_t member,
+            const cb::SmartPointer<re2::RE2> &re) :
+        methods(methods), member(member), re(re) {}
+    };
+
+    std::map<std::string, std::string> patterns;
+    Node root;
+
+    // Single pass matching, indexed in route order
+    std::vector<Route> routes;
+    cb::SmartPointer<re2::RE2::Set> set;
+
+    typedef std::vector<std::pair<std::string, std::string> > args_t;
+
+  public:
+    Router();
+    ~Router();
+
+    void addCapture(const std::string &name, const std::string &pattern);
+    void add(unsigned methods, const std::string &path, member_t member);
+    void compileSet();
+
+    std::string toRegex(const std::string &path) const;
+    bool dispatch(Transaction &tx) const;
+
+  protected:
+    static void split(const std::string &path,
+                      std::vector<std::string> &segments);
+    const std::string &getPattern(const std::string &name) const;
+    const Handler *match(const Node &node,
+                         const std::vector<std::string> &segments,
+                         unsigned i, unsigned method, args_t &args) const;
+    const Route *matchSet(const std::string &path, unsigned method,
+                          args_t &args) const;
+  };
+}
@@ -0,0 +1,215 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "RowWriter.h"
+
+#include <cbang/db/maria/DB.h>
+
+#include <event2/buffer.h>
+
+#include <cstdio>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+namespace {
+  inline bool needsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+  }
+
+
+  // Returns the offset of the first byte needing escape, or length
+  unsigned scan(const char *s, unsigned length) {
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctrlMax = _mm_set1_epi8(0x1f);
+
+    for (; i + 16 <= length; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+
+      // Control characters are those where min(v, 0x1f) == v, unsigned
+      __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, ctrlMax), v);
+      __m128i hit = _mm_or_si128(ctrl, _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                    _mm_cmpeq_epi8(v, slash)));
+
+      int mask = _mm_movemask_epi8(hit);
+      if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < length; i++)
+      if (needsEscape(s[i])) return i;
+
+    return length;
+  }
+
+
+  inline bool isDigit(char c) {return '0' <= c && c <= '9';}
+
+
+  // Matches -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool isJSONNumber(const char *s, unsigned length) {
+    const char *end = s + length;
+
+    if (s < end && *s == '-') s++;
+    if (s == end) return false;
+    if (*s == '0') s++;
+    else if (isDigit(*s)) while (s < end && isDigit(*s)) s++;
+    else return false;
+
+    if (s < end && *s == '.') {
+      if (++s == end || !isDigit(*s)) return false;
+      while (s < end && isDigit(*s)) s++;
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+      if (++s < end && (*s == '+' || *s == '-')) s++;
+      if (s == end || !isDigit(*s)) return false;
+      while (s < end && isDigit(*s)) s++;
+    }
+
+    return s == end;
+  }
+}
+
+
+void RowWriter::begin(const MariaDB::DB &db, unsigned count) {
+  prefixes.resize(count);
+  numbers.resize(count);
+  rows = 0;
+
+  for (unsigned i = 0; i < count; i++) {
+    MariaDB::Field field = db.getField(i);
+    string name = field.getName();
+
+    string &prefix = prefixes[i];
+    prefix = i ? "," : "";
+    appendString(prefix, name.data(), name.length());
+    prefix += ':';
+
+    numbers[i] = field.isNumber();
+  }
+}
+
+
+void RowWriter::begin(const MariaDB::DB &db) {begin(db, db.getFieldCount());}
+
+
+void RowWriter::writeRow(const MariaDB::DB &db) {
+  if (rows++) out += ',';
+
+  if (prefixes.size() == 1) writeField(db, 0);
+  else {
+    out += '{';
+    writePairs(db);
+    out += '}';
+  }
+}
+
+
+void RowWriter::writeFields(const MariaDB::DB &db) {
+  if (rows++) out += ',';
+  writePairs(db);
+}
+
+
+void RowWriter::appendString(string &out, const char *s, unsigned length) {
+  out += '"';
+
+  while (length) {
+    unsigned n = scan(s, length);
+    out.append(s, n);
+    if (n == length) break;
+
+    unsigned char c = s[n];
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\b': out += "\\b"; break;
+    case '\f': out += "\\f"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default: {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+      break;
+    }
+    }
+
+    s += n + 1;
+    length -= n + 1;
+  }
+
+  out += '"';
+}
+
+
+void RowWriter::flush(evbuffer *buffer) {
+  if (out.empty()) return;
+  evbuffer_add(buffer, out.data(), out.length());
+  out.clear();
+}
+
+
+void RowWriter::clear() {
+  out.clear();
+  rows = 0;
+}
+
+
+void RowWriter::writePairs(const MariaDB::DB &db) {
+  for (unsigned i = 0; i < prefixes.size(); i++) {
+    out += prefixes[i];
+    writeField(db, i);
+  }
+}
+
+
+void RowWriter::writeField(const MariaDB::DB &db, unsigned i) {
+  const char *data = db.getData(i);
+  unsigned length = db.getLength(i);
+
+  if (db.getNull(i)) out += "null";
+  else if (numbers[i] && isJSONNumber(data, length)) out.append(data, length);
+  else appendString(out, data, length); // Also quotes inf, nan, etc.
+}
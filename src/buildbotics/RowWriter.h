@@ -0,0 +1,83 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct evbuffer;
+
+namespace cb {namespace MariaDB {class DB;}}
+
+
+namespace Buildbotics {
+  // Serializes DB rows straight to JSON text.  The quoted column name
+  // prefixes are built once per result set and output is collected in a
+  // reused string, so steady state rows cost no allocations.
+  class RowWriter {
+    std::vector<std::string> prefixes; // ',"name":', without ',' for the first
+    std::vector<bool> numbers;
+    std::string out;
+    unsigned rows;
+
+  public:
+    RowWriter() : rows(0) {}
+
+    unsigned getRows() const {return rows;}
+
+    // Columns at or after count are not written
+    void begin(const cb::MariaDB::DB &db, unsigned count);
+    void begin(const cb::MariaDB::DB &db);
+
+    // Writes a dict, or the bare value for single column results, with a
+    // leading ',' after the first row
+    void writeRow(const cb::MariaDB::DB &db);
+
+    // Writes the '"name":value' pairs only, for a dict already open
+    void writeFields(const cb::MariaDB::DB &db);
+
+    void append(const std::string &s) {out += s;}
+    void append(char c) {out += c;}
+    void appendString(const char *s, unsigned length)
+    {appendString(out, s, length);}
+    static void appendString(std::string &out, const char *s,
+                             unsigned length);
+
+    void flush(evbuffer *buffer);
+    void clear();
+
+  protected:
+    void writePairs(const cb::MariaDB::DB &db);
+    void writeField(const cb::MariaDB::DB &db, unsigned i);
+  };
+}
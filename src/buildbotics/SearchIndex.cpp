@@ -0,0 +1,364 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "SearchIndex.h"
+#include "App.h"
+
+#include <cbang/String.h>
+#include <cbang/Exception.h>
+#include <cbang/log/Logger.h>
+#include <cbang/event/Event.h>
+#include <cbang/event/HTTPStatus.h>
+#include <cbang/json/Writer.h>
+
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+namespace {
+  struct Hit {
+    double score;
+    int64_t rank;
+    int64_t rank2;
+    uint32_t id;
+
+    Hit(double score, int64_t rank, int64_t rank2, uint32_t id) :
+      score(score), rank(rank), rank2(rank2), id(id) {}
+
+    // Greater is better
+    bool operator<(const Hit &o) const {
+      if (score != o.score) return score < o.score;
+      if (rank != o.rank) return rank < o.rank;
+      if (rank2 != o.rank2) return rank2 < o.rank2;
+      return o.id < id;
+    }
+
+    bool operator>(const Hit &o) const {return o < *this;}
+
+
+    static Hit parse(const vector<string> &key) {
+      try {
+        return Hit(String::parseDouble(key.at(0)),
+                   String::parseS64(key.at(1)), String::parseS64(key.at(2)),
+                   String::parseU32(key.at(3)));
+      } catch (const Exception &) {
+        THROWX("Invalid cursor", Event::HTTPStatus::HTTP_BAD_REQUEST);
+      }
+    }
+
+
+    string toString() const {
+      char buf[128];
+      snprintf(buf, sizeof(buf), "%.17g:%lld:%lld:%u", score, (long long)rank,
+               (long long)rank2, (unsigned)id);
+      return buf;
+    }
+  };
+
+
+  // Keeps the best k hits, optionally only those after a cursor, in a
+  // min-heap
+  class TopK {
+    uint64_t k;
+    bool hasAfter;
+    Hit after;
+    priority_queue<Hit, vector<Hit>, greater<Hit> > heap;
+
+  public:
+    TopK(uint64_t k, const vector<string> &after) :
+      k(k), hasAfter(!after.empty()),
+      after(hasAfter ? Hit::parse(after) : Hit(0, 0, 0, 0)) {}
+
+    void add(const Hit &hit) {
+      if (hasAfter && !(hit < after)) return;
+      if (heap.size() < k) heap.push(hit);
+      else if (k && heap.top() < hit) {
+        heap.pop();
+        heap.push(hit);
+      }
+    }
+
+    void get(unsigned offset, unsigned limit, vector<uint32_t> &ids,
+             string &next) {
+      vector<Hit> hits;
+      hits.reserve(heap.size());
+
+      while (!heap.empty()) {
+        hits.push_back(heap.top());
+        heap.pop();
+      }
+
+      // Worst first
+      for (unsigned i = hits.size(); offset < i; i--)
+        ids.push_back(hits[i - 1 - offset].id);
+
+      if (limit && ids.size() == limit) next = hits[0].toString();
+    }
+  };
+}
+
+
+SearchIndex::SearchIndex(App &app) :
+  app(app), data(new Data), step(SYNC_IDLE), pending(false), ready(false),
+  version(0), nextVersion(0), rebuilds(0), updates(0), searches(0) {}
+
+
+void SearchIndex::init() {
+  syncEvent = app.getEventBase().newEvent(this, &SearchIndex::syncEventCB);
+  syncEvent->add(0);
+}
+
+
+void SearchIndex::sync() {
+  if (step != SYNC_IDLE) {
+    pending = true;
+    return;
+  }
+
+  if (!dead.isNull()) {
+    dead->close();
+    dead.release();
+  }
+
+  if (db.isNull()) db = app.getDBConnection();
+
+  pending = false;
+  step = SYNC_VERSION;
+  db->query(this, &SearchIndex::queryCB, "CALL GetSearchVersion()");
+}
+
+
+void SearchIndex::findThings(const string &query, const string &license,
+                             const vector<string> &after, unsigned offset,
+                             unsigned limit, vector<uint32_t> &ids,
+                             string &next) {
+  TopK top((uint64_t)offset + limit, after);
+  searches++;
+
+  if (String::trim(query).empty()) {
+    for (auto it = data->things.begin(); it != data->things.end(); it++)
+      if (license.empty() || it->second.license == license)
+        top.add(Hit(0, it->second.stars, it->second.created, it->first));
+
+  } else {
+    vector<string> terms;
+    TextIndex::tokenize(query, terms);
+
+    TextIndex::scores_t scores;
+    data->thingText.score(terms, scores);
+
+    for (auto it = scores.begin(); it != scores.end(); it++) {
+      auto it2 = data->things.find(it->first);
+      if (it2 == data->things.end()) continue;
+
+      const Thing &thing = it2->second;
+      if (license.empty() || thing.license == license)
+        top.add(Hit(it->second, thing.stars, thing.created, it->first));
+    }
+  }
+
+  top.get(offset, limit, ids, next);
+}
+
+
+void SearchIndex::findProfiles(const string &query,
+                               const vector<string> &after, unsigned offset,
+                               unsigned limit, vector<uint32_t> &ids,
+                               string &next) {
+  TopK top((uint64_t)offset + limit, after);
+  searches++;
+
+  // Earlier joined ranks higher
+  if (String::trim(query).empty()) {
+    for (auto it = data->profiles.begin(); it != data->profiles.end(); it++)
+      top.add(Hit(0, it->second.points, -(int64_t)it->second.joined,
+                  it->first));
+
+  } else {
+    vector<string> terms;
+    TextIndex::tokenize(query, terms);
+
+    TextIndex::scores_t scores;
+    data->profileText.score(terms, scores);
+
+    for (auto it = scores.begin(); it != scores.end(); it++) {
+      auto it2 = data->profiles.find(it->first);
+      if (it2 == data->profiles.end()) continue;
+
+      const Profile &profile = it2->second;
+      top.add(Hit(it->second, profile.points, -(int64_t)profile.joined,
+                  it->first));
+    }
+  }
+
+  top.get(offset, limit, ids, next);
+}
+
+
+void SearchIndex::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("ready", ready);
+  writer.insert("version", version);
+  writer.insert("things", data->things.size());
+  writer.insert("thing_terms", data->thingText.getTermCount());
+  writer.insert("profiles", data->profiles.size());
+  writer.insert("profile_terms", data->profileText.getTermCount());
+  writer.insert("rebuilds", rebuilds);
+  writer.insert("updates", updates);
+  writer.insert("searches", searches);
+  writer.endDict();
+}
+
+
+void SearchIndex::updateThing() {
+  Data &d = next.isNull() ? *data : *next;
+  uint32_t id = db->getU32(0);
+
+  if (!db->getBoolean(1)) {
+    d.thingText.remove(id);
+    d.things.erase(id);
+    return;
+  }
+
+  Thing &thing = d.things[id];
+  thing.license = db->getString(2);
+  thing.stars = db->getU32(3);
+  thing.created = db->getU64(4);
+  d.thingText.add(id, db->getString(5));
+
+  if (next.isNull()) updates++;
+}
+
+
+void SearchIndex::updateProfile() {
+  Data &d = next.isNull() ? *data : *next;
+  uint32_t id = db->getU32(0);
+
+  if (!db->getBoolean(1)) {
+    d.profileText.remove(id);
+    d.profiles.erase(id);
+    return;
+  }
+
+  Profile &profile = d.profiles[id];
+  profile.points = String::parseS32(db->getString(2));
+  profile.joined = db->getU64(3);
+  d.profileText.add(id, db->getString(4));
+
+  if (next.isNull()) updates++;
+}
+
+
+void SearchIndex::queryCB(MariaDB::EventDB::state_t state) {
+  switch (state) {
+  case MariaDB::EventDB::EVENTDB_ROW:
+    switch (step) {
+    case SYNC_VERSION: {
+      uint64_t min = db->getU64(0);
+      uint64_t max = db->getU64(1);
+
+      // Rebuild if changes were trimmed before we saw them
+      if (!ready || max < version || (min && version + 1 < min))
+        next = new Data;
+
+      nextVersion = max;
+      break;
+    }
+
+    case SYNC_THINGS: updateThing(); break;
+    case SYNC_PROFILES: updateProfile(); break;
+    default: break;
+    }
+    break;
+
+  case MariaDB::EventDB::EVENTDB_DONE: {
+    string args = next.isNull() ? String(version) : string("null");
+    args += ", " + String(app.getCommitWindow());
+
+    switch (step) {
+    case SYNC_VERSION:
+      step = SYNC_THINGS;
+      db->query(this, &SearchIndex::queryCB,
+                "CALL GetSearchThings(" + args + ")");
+      break;
+
+    case SYNC_THINGS:
+      step = SYNC_PROFILES;
+      db->query(this, &SearchIndex::queryCB,
+                "CALL GetSearchProfiles(" + args + ")");
+      break;
+
+    case SYNC_PROFILES:
+      if (!next.isNull()) {
+        data = next;
+        next.release();
+        rebuilds++;
+
+        LOG_INFO(1, "Search index loaded " << data->things.size()
+                 << " things and " << data->profiles.size() << " profiles");
+      }
+
+      version = nextVersion;
+      ready = true;
+      step = SYNC_IDLE;
+      if (pending) syncEvent->add(0);
+      break;
+
+    default: break;
+    }
+    break;
+  }
+
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    LOG_WARNING("Search index sync failed: " << db->getError());
+    next.release();
+    step = SYNC_IDLE;
+
+    // Cannot free the connection from inside its own callback
+    dead = db;
+    db.release();
+    break;
+
+  default: break;
+  }
+}
+
+
+void SearchIndex::syncEventCB(Event::Event &e, int signal, unsigned flags) {
+  e.add(app.getSearchSyncPeriod());
+  sync();
+}
@@ -0,0 +1,133 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include "TextIndex.h"
+
+#include <cbang/SmartPointer.h>
+#include <cbang/db/maria/EventDB.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {class Writer;}
+}
+
+
+namespace Buildbotics {
+  class App;
+
+  // Full text search over published things and profiles.  Loaded from the DB
+  // at startup and kept current by polling the search_changes table.
+  class SearchIndex {
+    App &app;
+
+    struct Thing {
+      std::string license;
+      int32_t stars;
+      uint64_t created;
+    };
+
+    struct Profile {
+      int32_t points;
+      uint64_t joined;
+    };
+
+    struct Data {
+      TextIndex thingText;
+      std::unordered_map<uint32_t, Thing> things;
+
+      TextIndex profileText;
+      std::unordered_map<uint32_t, Profile> profiles;
+    };
+
+    cb::SmartPointer<Data> data;
+    cb::SmartPointer<Data> next; // Full rebuild in progress
+
+    typedef enum {
+      SYNC_IDLE,
+      SYNC_VERSION,
+      SYNC_THINGS,
+      SYNC_PROFILES,
+    } sync_t;
+
+    sync_t step;
+    bool pending;
+    bool ready;
+    uint64_t version;
+    uint64_t nextVersion;
+
+    cb::SmartPointer<cb::MariaDB::EventDB> db;
+    cb::SmartPointer<cb::MariaDB::EventDB> dead;
+    cb::SmartPointer<cb::Event::Event> syncEvent;
+
+    // Stats
+    uint64_t rebuilds;
+    uint64_t updates;
+    uint64_t searches;
+
+  public:
+    SearchIndex(App &app);
+
+    void init();
+    void sync();
+
+    bool isReady() const {return ready;}
+
+    // Results follow the item with the sort key after, if not empty, and next
+    // is set to the last item's sort key if the page is full
+    static const unsigned CURSOR_SIZE = 4;
+
+    void findThings(const std::string &query, const std::string &license,
+                    const std::vector<std::string> &after, unsigned offset,
+                    unsigned limit, std::vector<uint32_t> &ids,
+                    std::string &next);
+    void findProfiles(const std::string &query,
+                      const std::vector<std::string> &after, unsigned offset,
+                      unsigned limit, std::vector<uint32_t> &ids,
+                      std::string &next);
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void updateThing();
+    void updateProfile();
+
+    void queryCB(cb::MariaDB::EventDB::state_t state);
+    void syncEventCB(cb::Event::Event &e, int signal, unsigned flags);
+  };
+}
@@ -32,13 +32,14 @@
 #include "Server.h"
 #include "App.h"
 #include "Transaction.h"
+#include "Router.h"
+#include "StaticHandler.h"
 
 #include <cbang/openssl/SSLContext.h>
 
 #include <cbang/event/Request.h>
 #include <cbang/event/Buffer.h>
 #include <cbang/event/RedirectSecure.h>
-#include <cbang/event/ResourceHTTPHandler.h>
 #include <cbang/event/FileHandler.h>
 
 #include <cbang/config/Options.h>
@@ -86,87 +87,127 @@ void Server::init() {
 #define NAME_RE "[\\w_.]+"
 #define FILENAME_RE "[^/]+"
 #define TAG_RE "[\\w. -]+"
-#define PROFILE_RE "/api/profiles/(?P<profile>" NAME_RE ")"
-#define PROFILE_AVATAR_RE PROFILE_RE "/avatar/(?P<file>" FILENAME_RE ")"
-#define THING_RE PROFILE_RE "/things/(?P<thing>" NAME_RE ")"
-#define STAR_RE THING_RE "/star"
-#define COMMENTS_RE THING_RE "/comments"
-#define COMMENT_RE COMMENTS_RE                          \
-  "/(?P<comment>\\d+)(/owner/(?P<owner>" NAME_RE "))?"
-#define FILE_RE THING_RE "/files/(?P<file>" FILENAME_RE ")"
-#define THING_TAGS_RE THING_RE "/tags/(?P<tags>" TAG_RE "(," TAG_RE ")*)"
-#define TAGS_RE "/api/tags"
-#define TAG_PATH_RE TAGS_RE "/(?P<tag>" TAG_RE "(," TAG_RE ")*)"
+#define TAG_LIST_RE TAG_RE "(," TAG_RE ")*"
 #define FILE_URL_RE                                                     \
   "/(?P<profile>" NAME_RE ")/(?P<thing>" NAME_RE ")/(?P<file>" FILENAME_RE ")"
 
+  // Route captures
+  router.addCapture("provider", "(google)|(github)|(twitter)|(facebook)");
+  router.addCapture("profile", NAME_RE);
+  router.addCapture("thing", NAME_RE);
+  router.addCapture("owner", NAME_RE);
+  router.addCapture("file", FILENAME_RE);
+  router.addCapture("comment", "\\d+");
+  router.addCapture("tags", TAG_LIST_RE);
+  router.addCapture("tag", TAG_LIST_RE);
+
+#define ADD_ROUTE(METHODS, PATH, FUNC)                                  \
+  routes.push_back(Route(METHODS, PATH, &Transaction::FUNC))
+
+#define PROFILE_PATH "/api/profiles/{profile}"
+#define PROFILE_AVATAR_PATH PROFILE_PATH "/avatar/{file}"
+#define THING_PATH PROFILE_PATH "/things/{thing}"
+#define STAR_PATH THING_PATH "/star"
+#define COMMENTS_PATH THING_PATH "/comments"
+#define COMMENT_PATH COMMENTS_PATH "/{comment}"
+#define COMMENT_OWNER_PATH COMMENT_PATH "/owner/{owner}"
+#define FILE_PATH THING_PATH "/files/{file}"
+#define THING_TAGS_PATH THING_PATH "/tags/{tags}"
+#define TAGS_PATH "/api/tags"
+#define TAG_PATH TAGS_PATH "/{tag}"
+
   // Auth
-  ADD_TM(api, HTTP_GET, "/api/auth/user", apiAuthUser);
-  ADD_TM(api, HTTP_GET | HTTP_POST,
-         "/api/auth/(?P<provider>(google)|(github)|(twitter)|(facebook))"
-         "(/callback)?", apiAuthLogin);
-  ADD_TM(api, HTTP_GET, "/api/auth/logout", apiAuthLogout);
+  ADD_ROUTE(HTTP_GET, "/api/auth/user", apiAuthUser);
+  ADD_ROUTE(HTTP_GET | HTTP_POST, "/api/auth/{provider}", apiAuthLogin);
+  ADD_ROUTE(HTTP_GET | HTTP_POST, "/api/auth/{provider}/callback",
+            apiAuthLogin);
+  ADD_ROUTE(HTTP_GET, "/api/auth/logout", apiAuthLogout);
+
+  // Batch
+  ADD_ROUTE(HTTP_POST, "/api/batch", apiBatch);
 
   // Info
-  ADD_TM(api, HTTP_GET, "/api/info", apiGetInfo);
+  ADD_ROUTE(HTTP_GET, "/api/info", apiGetInfo);
+  ADD_ROUTE(HTTP_GET, "/api/stats", apiGetStats);
 
   // Permissions
-  ADD_TM(api, HTTP_GET, "/api/permissions", apiGetPermissions);
+  ADD_ROUTE(HTTP_GET, "/api/permissions", apiGetPermissions);
 
   // Profiles
-  ADD_TM(api, HTTP_GET, "/api/profiles", apiGetProfiles);
-  ADD_TM(api, HTTP_PUT, PROFILE_RE "/register", apiProfileRegister);
-  ADD_TM(api, HTTP_GET, PROFILE_RE "/available", apiProfileAvailable);
-  ADD_TM(api, HTTP_GET, "/api/suggest", apiProfileSuggest);
-  ADD_TM(api, HTTP_PUT, PROFILE_RE, apiPutProfile);
-  ADD_TM(api, HTTP_GET, PROFILE_RE, apiGetProfile);
-  ADD_TM(api, HTTP_GET, PROFILE_RE "/avatar", apiGetProfileAvatar);
-  ADD_TM(api, HTTP_PUT, PROFILE_AVATAR_RE , apiPutProfileAvatar);
-  ADD_TM(api, HTTP_PUT, PROFILE_AVATAR_RE "/confirm" , apiConfirmProfileAvatar);
+  ADD_ROUTE(HTTP_GET, "/api/profiles", apiGetProfiles);
+  ADD_ROUTE(HTTP_PUT, PROFILE_PATH "/register", apiProfileRegister);
+  ADD_ROUTE(HTTP_GET, PROFILE_PATH "/available", apiProfileAvailable);
+  ADD_ROUTE(HTTP_GET, "/api/suggest", apiProfileSuggest);
+  ADD_ROUTE(HTTP_PUT, PROFILE_PATH, apiPutProfile);
+  ADD_ROUTE(HTTP_GET, PROFILE_PATH, apiGetProfile);
+  ADD_ROUTE(HTTP_GET, PROFILE_PATH "/avatar", apiGetProfileAvatar);
+  ADD_ROUTE(HTTP_PUT, PROFILE_AVATAR_PATH, apiPutProfileAvatar);
+  ADD_ROUTE(HTTP_PUT, PROFILE_AVATAR_PATH "/confirm", apiConfirmProfileAvatar);
 
   // Follow
-  ADD_TM(api, HTTP_PUT, PROFILE_RE "/follow", apiFollow);
-  ADD_TM(api, HTTP_DELETE, PROFILE_RE "/follow", apiUnfollow);
+  ADD_ROUTE(HTTP_PUT, PROFILE_PATH "/follow", apiFollow);
+  ADD_ROUTE(HTTP_DELETE, PROFILE_PATH "/follow", apiUnfollow);
 
   // Things
-  ADD_TM(api, HTTP_GET, "/api/things", apiGetThings);
-  ADD_TM(api, HTTP_GET, THING_RE "/available", apiThingAvailable);
-  ADD_TM(api, HTTP_GET, THING_RE, apiGetThing);
-  ADD_TM(api, HTTP_PUT, THING_RE, apiPutThing);
-  ADD_TM(api, HTTP_PUT, THING_RE "/publish", apiPublishThing);
-  ADD_TM(api, HTTP_PUT, THING_RE "/rename", apiRenameThing);
-  ADD_TM(api, HTTP_DELETE, THING_RE, apiDeleteThing);
+  ADD_ROUTE(HTTP_GET, "/api/things", apiGetThings);
+  ADD_ROUTE(HTTP_GET, THING_PATH "/available", apiThingAvailable);
+  ADD_ROUTE(HTTP_GET, THING_PATH, apiGetThing);
+  ADD_ROUTE(HTTP_PUT, THING_PATH, apiPutThing);
+  ADD_ROUTE(HTTP_PUT, THING_PATH "/publish", apiPublishThing);
+  ADD_ROUTE(HTTP_PUT, THING_PATH "/rename", apiRenameThing);
+  ADD_ROUTE(HTTP_DELETE, THING_PATH, apiDeleteThing);
 
   // Stars
-  ADD_TM(api, HTTP_PUT, STAR_RE, apiStarThing);
-  ADD_TM(api, HTTP_DELETE, STAR_RE, apiUnstarThing);
+  ADD_ROUTE(HTTP_PUT, STAR_PATH, apiStarThing);
+  ADD_ROUTE(HTTP_DELETE, STAR_PATH, apiUnstarThing);
 
   // Comments
-  ADD_TM(api, HTTP_POST, COMMENTS_RE, apiPostComment);
-  ADD_TM(api, HTTP_PUT, COMMENT_RE, apiUpdateComment);
-  ADD_TM(api, HTTP_DELETE, COMMENT_RE, apiDeleteComment);
-  ADD_TM(api, HTTP_PUT, COMMENT_RE "/up", apiUpvoteComment);
-  ADD_TM(api, HTTP_PUT, COMMENT_RE "/down", apiDownvoteComment);
+  ADD_ROUTE(HTTP_POST, COMMENTS_PATH, apiPostComment);
+  ADD_ROUTE(HTTP_PUT, COMMENT_PATH, apiUpdateComment);
+  ADD_ROUTE(HTTP_PUT, COMMENT_OWNER_PATH, apiUpdateComment);
+  ADD_ROUTE(HTTP_DELETE, COMMENT_PATH, apiDeleteComment);
+  ADD_ROUTE(HTTP_DELETE, COMMENT_OWNER_PATH, apiDeleteComment);
+  ADD_ROUTE(HTTP_PUT, COMMENT_PATH "/up", apiUpvoteComment);
+  ADD_ROUTE(HTTP_PUT, COMMENT_OWNER_PATH "/up", apiUpvoteComment);
+  ADD_ROUTE(HTTP_PUT, COMMENT_PATH "/down", apiDownvoteComment);
+  ADD_ROUTE(HTTP_PUT, COMMENT_OWNER_PATH "/down", apiDownvoteComment);
 
   // Files
-  ADD_TM(api, HTTP_POST, FILE_RE, apiUploadFile);
-  ADD_TM(api, HTTP_PUT, FILE_RE, apiUpdateFile);
-  ADD_TM(api, HTTP_DELETE, FILE_RE, apiDeleteFile);
-  ADD_TM(api, HTTP_PUT, FILE_RE "/confirm", apiConfirmFile);
-  ADD_TM(api, HTTP_POST, FILE_RE "/up", apiFileUp);
-  ADD_TM(api, HTTP_POST, FILE_RE "/down", apiFileDown);
+  ADD_ROUTE(HTTP_POST, FILE_PATH, apiUploadFile);
+  ADD_ROUTE(HTTP_PUT, FILE_PATH, apiUpdateFile);
+  ADD_ROUTE(HTTP_DELETE, FILE_PATH, apiDeleteFile);
+  ADD_ROUTE(HTTP_PUT, FILE_PATH "/confirm", apiConfirmFile);
+  ADD_ROUTE(HTTP_POST, FILE_PATH "/up", apiFileUp);
+  ADD_ROUTE(HTTP_POST, FILE_PATH "/down", apiFileDown);
 
   // Tags
-  ADD_TM(api, HTTP_GET, TAGS_RE, apiGetTags);
-  ADD_TM(api, HTTP_GET, TAG_PATH_RE, apiGetTagThings);
-  ADD_TM(api, HTTP_PUT, THING_TAGS_RE, apiTagThing);
-  ADD_TM(api, HTTP_DELETE, THING_TAGS_RE, apiUntagThing);
+  ADD_ROUTE(HTTP_GET, TAGS_PATH, apiGetTags);
+  ADD_ROUTE(HTTP_GET, TAG_PATH, apiGetTagThings);
+  ADD_ROUTE(HTTP_PUT, THING_TAGS_PATH, apiTagThing);
+  ADD_ROUTE(HTTP_DELETE, THING_TAGS_PATH, apiUntagThing);
 
   // Licenses
-  ADD_TM(api, HTTP_GET, "/api/licenses", apiGetLicenses);
+  ADD_ROUTE(HTTP_GET, "/api/licenses", apiGetLicenses);
 
   // Events
-  ADD_TM(api, HTTP_GET, "/api/events", apiGetEvents);
+  ADD_ROUTE(HTTP_GET, "/api/events", apiGetEvents);
+  ADD_ROUTE(HTTP_GET, "/api/events/poll", apiPollEvents);
+
+  // Dispatch
+  const string &mode = app.getAPIRouter();
+  if (mode == "trie" || mode == "set") {
+    for (unsigned i = 0; i < routes.size(); i++)
+      router.add(routes[i].methods, routes[i].path, routes[i].member);
+    if (mode == "set") router.compileSet();
+    ADD_TM(api, HTTP_ANY, "", apiRoute);
+
+  } else if (mode == "regex") {
+    for (unsigned i = 0; i < routes.size(); i++)
+      api.addMember<Transaction>(routes[i].methods,
+                                 router.toRegex(routes[i].path),
+                                 routes[i].member);
+
+  } else THROW("Invalid api-router '" << mode << "'");
 
   // API not found
   ADD_TM(api, HTTP_ANY, "", apiNotFound);
@@ -175,12 +216,13 @@ void Server::init() {
   HTTPHandlerGroup &docs = *addGroup(HTTP_ANY, "/docs/.*");
   if (app.getOptions()["http-root"].hasValue())
     docs.addHandler(app.getOptions()["http-root"]);
-  else docs.addHandler(*resource0.find("http"));
+  else docs.addHandler(HTTP_GET | HTTP_HEAD, "",
+                         new StaticHandler(*resource0.find("http")));
 
   docs.addMember<Transaction>(HTTP_ANY, ".*\\..*", &Transaction::notFound);
 
   // Download files
-  ADD_TM(*this, HTTP_GET, FILE_URL_RE, apiDownloadFile);
+  ADD_TM(*this, HTTP_GET | HTTP_HEAD, FILE_URL_RE, apiDownloadFile);
 
   // Root
   if (app.getOptions()["http-root"].hasValue()) {
@@ -189,10 +231,8 @@ void Server::init() {
     addHandler(root);
     addHandler(root + "/index.html");
 
-  } else {
-    addHandler(*resource0.find("http"));
-    addHandler(*resource0.find("http/index.html"));
-  }
+  } else addHandler(HTTP_GET | HTTP_HEAD, "",
+                    new StaticHandler(*resource0.find("http"), "index.html"));
 }
 
 
@@ -31,8 +31,13 @@
 
 #pragma once
 
+#include "Router.h"
+
 #include <cbang/event/WebServer.h>
 
+#include <string>
+#include <vector>
+
 
 namespace Buildbotics {
   class App;
@@ -41,9 +46,24 @@ namespace Buildbotics {
   class Server : public cb::Event::WebServer {
     App &app;
 
+    struct Route {
+      unsigned methods;
+      std::string path;
+      Router::member_t member;
+
+      Route(unsigned methods, const std::string &path,
+            Router::member_t member) :
+        methods(methods), path(path), member(member) {}
+    };
+
+    std::vector<Route> routes;
+    Router router;
+
   public:
     Server(App &app);
 
+    const Router &getRouter() const {return router;}
+
     void init();
 
     // From cb::Event::WebServer
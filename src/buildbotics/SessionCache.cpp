@@ -0,0 +1,173 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "SessionCache.h"
+#include "App.h"
+
+#include <cbang/time/Time.h>
+#include <cbang/json/Writer.h>
+
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+void SessionCache::Shard::evict(uint64_t now) {
+  while (!expires.empty() && expires.begin()->first < now) evictOne();
+}
+
+
+void SessionCache::Shard::evictOne() {
+  expires_t::iterator it = expires.begin();
+
+  // The entry may have been replaced since this index record was created
+  entries_t::iterator it2 = entries.find(it->second);
+  if (it2 != entries.end() && it2->second.expires == it->first)
+    entries.erase(it2);
+
+  expires.erase(it);
+}
+
+
+SessionCache::SessionCache(App &app) :
+  app(app), rsaTotal(0), rsaSecond(0) {
+  memset(rsaCounts, 0, sizeof(rsaCounts));
+}
+
+
+uint64_t SessionCache::hash(const string &session) {
+  // FNV-1a, sessions are already uniformly distributed
+  uint64_t h = 14695981039346656037ULL;
+
+  for (unsigned i = 0; i < session.length(); i++) {
+    h ^= (uint8_t)session[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+
+bool SessionCache::lookup(const string &session, Entry &entry) {
+  uint64_t h = hash(session);
+  Shard &shard = getShard(h);
+  lock_guard<mutex> lock(shard.lock);
+
+  shard.evict(Time::now());
+
+  Shard::entries_t::iterator it = shard.entries.find(h);
+  if (it == shard.entries.end() || it->second.session != session) {
+    shard.misses++;
+    return false;
+  }
+
+  shard.hits++;
+  entry = it->second;
+
+  return true;
+}
+
+
+void SessionCache::insert(const Entry &entry) {
+  uint64_t h = hash(entry.session);
+  Shard &shard = getShard(h);
+  lock_guard<mutex> lock(shard.lock);
+
+  shard.evict(Time::now());
+
+  // Make room, soonest to expire first
+  unsigned maxEntries = app.getSessionCacheSize() / SHARDS + 1;
+  while (maxEntries <= shard.entries.size() && !shard.expires.empty())
+    shard.evictOne();
+
+  shard.entries[h] = entry;
+  shard.expires.insert(Shard::expires_t::value_type(entry.expires, h));
+}
+
+
+void SessionCache::countRSA() {
+  uint64_t now = Time::now();
+  lock_guard<mutex> lock(rsaLock);
+
+  // Clear buckets which have passed out of the window
+  if (rsaSecond + RATE_WINDOW <= now) memset(rsaCounts, 0, sizeof(rsaCounts));
+  else while (rsaSecond < now) rsaCounts[++rsaSecond % RATE_WINDOW] = 0;
+
+  rsaSecond = now;
+  rsaCounts[now % RATE_WINDOW]++;
+  rsaTotal++;
+}
+
+
+uint64_t SessionCache::getRSATotal() const {
+  lock_guard<mutex> lock(rsaLock);
+  return rsaTotal;
+}
+
+
+double SessionCache::getRSARate() const {
+  uint64_t now = Time::now();
+  lock_guard<mutex> lock(rsaLock);
+
+  // Average over the complete seconds in the window
+  uint64_t count = 0;
+  for (unsigned i = 1; i < RATE_WINDOW; i++)
+    if (now - i <= rsaSecond && rsaSecond < now - i + RATE_WINDOW)
+      count += rsaCounts[(now - i) % RATE_WINDOW];
+
+  return (double)count / (RATE_WINDOW - 1);
+}
+
+
+void SessionCache::write(JSON::Writer &writer) const {
+  uint64_t size = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  for (unsigned i = 0; i < SHARDS; i++) {
+    Shard &shard = shards[i];
+    lock_guard<mutex> lock(shard.lock);
+
+    size += shard.entries.size();
+    hits += shard.hits;
+    misses += shard.misses;
+  }
+
+  writer.beginDict();
+  writer.insert("size", size);
+  writer.insert("hits", hits);
+  writer.insert("misses", misses);
+  writer.insert("rsa_ops", getRSATotal());
+  writer.insert("rsa_ops_per_sec", getRSARate());
+  writer.endDict();
+}
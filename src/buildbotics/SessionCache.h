@@ -0,0 +1,106 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+namespace cb {namespace JSON {class Writer;}}
+
+
+namespace Buildbotics {
+  class App;
+
+  class SessionCache {
+  public:
+    struct Entry {
+      std::string session;
+      uint64_t expires;
+      std::string provider;
+      std::string id;
+      std::string name;
+      uint64_t auth;
+    };
+
+    static const unsigned SHARDS = 16;
+    static const unsigned RATE_WINDOW = 60;
+
+  protected:
+    App &app;
+
+    struct Shard {
+      std::mutex lock;
+
+      typedef std::unordered_map<uint64_t, Entry> entries_t;
+      entries_t entries;
+
+      typedef std::multimap<uint64_t, uint64_t> expires_t;
+      expires_t expires; // expires -> hash
+
+      uint64_t hits;
+      uint64_t misses;
+
+      Shard() : hits(0), misses(0) {}
+
+      void evict(uint64_t now);
+      void evictOne();
+    };
+
+    mutable Shard shards[SHARDS];
+
+    // RSA operation counter
+    mutable std::mutex rsaLock;
+    uint64_t rsaTotal;
+    uint64_t rsaSecond;
+    uint32_t rsaCounts[RATE_WINDOW];
+
+  public:
+    SessionCache(App &app);
+
+    static uint64_t hash(const std::string &session);
+
+    bool lookup(const std::string &session, Entry &entry);
+    void insert(const Entry &entry);
+
+    void countRSA();
+    uint64_t getRSATotal() const;
+    double getRSARate() const;
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    Shard &getShard(uint64_t hash) {return shards[hash % SHARDS];}
+  };
+}
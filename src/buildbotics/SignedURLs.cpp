@@ -0,0 +1,96 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "SignedURLs.h"
+#include "App.h"
+#include "AWS4PresignedURL.h"
+
+#include <cbang/time/Time.h>
+#include <cbang/json/Writer.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+SignedURLs::SignedURLs(App &app) : app(app), hits(0), misses(0) {}
+
+
+string SignedURLs::get(const string &path) {
+  uint64_t now = Time::now();
+
+  entries_t::iterator it = entries.find(path);
+  if (it != entries.end()) {
+    if (now + app.getAWSDownloadRenew() < it->second.expires) {
+      hits++;
+      return it->second.url;
+    }
+
+    remove(it);
+  }
+
+  misses++;
+
+  unsigned expires = app.getAWSDownloadExpires();
+  AWS4PresignedURL url(URI(app.getAWSS3URL() + path),
+                       Event::RequestMethod::HTTP_GET, expires, now, "s3",
+                       app.getAWSRegion());
+  url.sign(app.getAWSID(), app.getAWSSecret());
+
+  // Only cache URLs which outlive the renewal margin
+  unsigned maxSize = app.getDownloadCacheSize();
+  if (!maxSize || expires <= app.getAWSDownloadRenew())
+    return url.toString();
+
+  while (maxSize <= entries.size()) remove(entries.find(order.front()));
+
+  Entry &entry = entries[path];
+  entry.url = url.toString();
+  entry.expires = now + expires;
+  entry.order = order.insert(order.end(), path);
+
+  return entry.url;
+}
+
+
+void SignedURLs::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("size", entries.size());
+  writer.insert("hits", hits);
+  writer.insert("misses", misses);
+  writer.endDict();
+}
+
+
+void SignedURLs::remove(entries_t::iterator it) {
+  order.erase(it->second.order);
+  entries.erase(it);
+}
@@ -0,0 +1,104 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "SingleFlight.h"
+#include "Transaction.h"
+
+#include <cbang/json/Writer.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+SingleFlight::SingleFlight() : leaders(0), followers(0), abandoned(0) {}
+
+
+bool SingleFlight::join(const string &key, Transaction &tx) {
+  Flight &flight = flights[key];
+
+  if (!flight.leader) {
+    flight.leader = &tx;
+    leaders++;
+    return false;
+  }
+
+  flight.followers.push_back(&tx);
+  followers++;
+  return true;
+}
+
+
+void SingleFlight::leave(const string &key, Transaction &tx) {
+  flights_t::iterator it = flights.find(key);
+  if (it == flights.end()) return;
+
+  Flight &flight = it->second;
+
+  if (flight.leader != &tx) {
+    flight.followers.remove(&tx);
+    return;
+  }
+
+  // The leader went away, followers run the query themselves
+  list<Transaction *> waiting;
+  waiting.swap(flight.followers);
+  flights.erase(it);
+  abandoned++;
+
+  for (auto it2 = waiting.begin(); it2 != waiting.end(); it2++)
+    (*it2)->retryFlight();
+}
+
+
+void SingleFlight::complete(const string &key, Transaction &tx,
+                            Event::HTTPStatus status, const string &data) {
+  flights_t::iterator it = flights.find(key);
+  if (it == flights.end() || it->second.leader != &tx) return;
+
+  // Followers may be freed as they reply
+  list<Transaction *> waiting;
+  waiting.swap(it->second.followers);
+  flights.erase(it);
+
+  for (auto it2 = waiting.begin(); it2 != waiting.end(); it2++)
+    (*it2)->flightDone(status, data, tx.getNextCursor());
+}
+
+
+void SingleFlight::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("in_flight", flights.size());
+  writer.insert("leaders", leaders);
+  writer.insert("followers", followers);
+  writer.insert("abandoned", abandoned);
+  writer.endDict();
+}
@@ -0,0 +1,74 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/event/HTTPStatus.h>
+
+#include <string>
+#include <map>
+#include <list>
+#include <cstdint>
+
+namespace cb {namespace JSON {class Writer;}}
+
+
+namespace Buildbotics {
+  class Transaction;
+
+  // Lets identical concurrent requests share one DB query
+  class SingleFlight {
+    struct Flight {
+      Transaction *leader;
+      std::list<Transaction *> followers;
+
+      Flight() : leader(0) {}
+    };
+
+    typedef std::map<std::string, Flight> flights_t;
+    flights_t flights;
+
+    // Stats
+    uint64_t leaders;
+    uint64_t followers;
+    uint64_t abandoned;
+
+  public:
+    SingleFlight();
+
+    bool join(const std::string &key, Transaction &tx);
+    void leave(const std::string &key, Transaction &tx);
+    void complete(const std::string &key, Transaction &tx,
+                  cb::Event::HTTPStatus status, const std::string &data);
+
+    void write(cb::JSON::Writer &writer) const;
+  };
+}
@@ -0,0 +1,118 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#include "StaticHandler.h"
+#include "Compression.h"
+
+#include <cbang/String.h>
+#include <cbang/event/Request.h>
+#include <cbang/event/Buffer.h>
+#include <cbang/util/Resource.h>
+
+#include <event2/buffer.h>
+
+#include <cstring>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+const char *StaticHandler::getContentType(const string &path) {
+  static const char *types[] = {
+    "html", "text/html; charset=utf-8",
+    "css", "text/css; charset=utf-8",
+    "js", "application/javascript; charset=utf-8",
+    "json", "application/json",
+    "svg", "image/svg+xml",
+    "txt", "text/plain; charset=utf-8",
+    "xml", "application/xml",
+    "png", "image/png",
+    "jpg", "image/jpeg",
+    "gif", "image/gif",
+    "ico", "image/x-icon",
+    "woff", "application/font-woff",
+    0,
+  };
+
+  size_t dot = path.rfind('.');
+  if (dot != string::npos && path.find('/', dot) == string::npos) {
+    string ext = String::toLower(path.substr(dot + 1));
+
+    for (unsigned i = 0; types[i]; i += 2)
+      if (ext == types[i]) return types[i + 1];
+  }
+
+  return "application/octet-stream";
+}
+
+
+bool StaticHandler::operator()(Event::Request &req) {
+  string path = req.getURI().getPath();
+  while (!path.empty() && path[0] == '/') path = path.substr(1);
+
+  const Resource *resource = path.empty() ? 0 : root.find(path);
+  if (!resource || resource->isDirectory()) {
+    if (!path.empty() && path[path.length() - 1] != '/') path += '/';
+    path += "index.html";
+    resource = root.find(path);
+  }
+
+  if ((!resource || resource->isDirectory()) && !fallback.empty())
+    resource = root.find(path = fallback);
+
+  if (!resource || resource->isDirectory()) return false;
+
+  req.setContentType(getContentType(path));
+
+  const Resource *gz = root.find(path + ".gz");
+  if (gz) {
+    req.outSet("Vary", "Accept-Encoding");
+
+    if (req.inHas("Accept-Encoding") &&
+        Compression::acceptsGzip(req.inGet("Accept-Encoding"))) {
+      req.outSet("Content-Encoding", "gzip");
+      resource = gz;
+    }
+  }
+
+  if (req.getMethod() == Event::RequestMethod::HTTP_HEAD)
+    req.outSet("Content-Length", String(resource->getLength()));
+
+  else if (resource->getLength())
+    evbuffer_add_reference(req.getOutputBuffer().getBuffer(),
+                           resource->getData(), resource->getLength(), 0, 0);
+
+  req.reply();
+
+  return true;
+}
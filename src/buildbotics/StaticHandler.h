@@ -0,0 +1,60 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <cbang/event/HTTPHandler.h>
+
+#include <string>
+
+namespace cb {class Resource;}
+
+
+namespace Buildbotics {
+  // Serves embedded resources.  Where the build stored a gzipped copy
+  // ('name.gz') it is sent as is to clients that accept gzip.  Data is added
+  // to the output by reference so a request costs no copying or compression.
+  // Paths not found are served 'fallback', if set, so client side routes work.
+  class StaticHandler : public cb::Event::HTTPHandler {
+    const cb::Resource &root;
+    std::string fallback;
+
+  public:
+    StaticHandler(const cb::Resource &root, const std::string &fallback = "") :
+      root(root), fallback(fallback) {}
+
+    static const char *getContentType(const std::string &path);
+
+    // From cb::Event::HTTPHandler
+    bool operator()(cb::Event::Request &req);
+  };
+}
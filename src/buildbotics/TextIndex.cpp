@@ -0,0 +1,131 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "TextIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+using namespace std;
+using namespace Buildbotics;
+
+
+const double TextIndex::K1 = 1.2;
+const double TextIndex::B = 0.75;
+
+
+void TextIndex::tokenize(const string &text, vector<string> &tokens) {
+  string token;
+
+  for (unsigned i = 0; i <= text.length(); i++) {
+    unsigned char c = i < text.length() ? text[i] : 0;
+
+    // Non-ASCII bytes are kept so UTF-8 words stay whole
+    if (isalnum(c) || 0x80 <= c) {
+      if (token.length() < MAX_TERM_LENGTH) token += tolower(c);
+
+    } else if (!token.empty()) {
+      if (MIN_TERM_LENGTH <= token.length()) tokens.push_back(token);
+      token.clear();
+    }
+  }
+}
+
+
+void TextIndex::add(uint32_t id, const string &text) {
+  remove(id);
+
+  vector<string> tokens;
+  tokenize(text, tokens);
+  if (tokens.empty()) return;
+
+  Doc &doc = docs[id];
+  doc.length = tokens.size();
+  totalLength += doc.length;
+
+  for (unsigned i = 0; i < tokens.size(); i++)
+    if (!terms[tokens[i]][id]++) doc.terms.push_back(tokens[i]);
+}
+
+
+void TextIndex::remove(uint32_t id) {
+  docs_t::iterator it = docs.find(id);
+  if (it == docs.end()) return;
+
+  const Doc &doc = it->second;
+
+  for (unsigned i = 0; i < doc.terms.size(); i++) {
+    terms_t::iterator it2 = terms.find(doc.terms[i]);
+    it2->second.erase(id);
+    if (it2->second.empty()) terms.erase(it2);
+  }
+
+  totalLength -= doc.length;
+  docs.erase(it);
+}
+
+
+void TextIndex::clear() {
+  terms.clear();
+  docs.clear();
+  totalLength = 0;
+}
+
+
+void TextIndex::score(const vector<string> &query, scores_t &scores) const {
+  if (docs.empty()) return;
+
+  double n = docs.size();
+  double avgLength = (double)totalLength / n;
+
+  vector<string> unique(query);
+  sort(unique.begin(), unique.end());
+  unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+  for (unsigned i = 0; i < unique.size(); i++) {
+    terms_t::const_iterator it = terms.find(unique[i]);
+    if (it == terms.end()) continue;
+
+    const postings_t &postings = it->second;
+    double df = postings.size();
+    double idf = log(1 + (n - df + 0.5) / (df + 0.5));
+
+    for (postings_t::const_iterator it2 = postings.begin();
+         it2 != postings.end(); it2++) {
+      double tf = it2->second;
+      double length = docs.find(it2->first)->second.length;
+      double norm = K1 * (1 - B + B * length / avgLength);
+
+      scores[it2->first] += idf * tf * (K1 + 1) / (tf + norm);
+    }
+  }
+}
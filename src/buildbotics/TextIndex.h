@@ -0,0 +1,80 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+
+namespace Buildbotics {
+  // In-memory inverted index with Okapi BM25 scoring
+  class TextIndex {
+    typedef std::unordered_map<uint32_t, uint32_t> postings_t; // doc -> freq
+    typedef std::unordered_map<std::string, postings_t> terms_t;
+    terms_t terms;
+
+    struct Doc {
+      uint32_t length;
+      std::vector<std::string> terms; // Unique
+    };
+
+    typedef std::unordered_map<uint32_t, Doc> docs_t;
+    docs_t docs;
+
+    uint64_t totalLength;
+
+  public:
+    typedef std::unordered_map<uint32_t, double> scores_t;
+
+    static const double K1;
+    static const double B;
+    static const unsigned MIN_TERM_LENGTH = 2;
+    static const unsigned MAX_TERM_LENGTH = 64;
+
+    TextIndex() : totalLength(0) {}
+
+    unsigned getSize() const {return docs.size();}
+    unsigned getTermCount() const {return terms.size();}
+
+    static void tokenize(const std::string &text,
+                         std::vector<std::string> &tokens);
+
+    void add(uint32_t id, const std::string &text);
+    void remove(uint32_t id);
+    void clear();
+
+    void score(const std::vector<std::string> &query, scores_t &scores) const;
+  };
+}
@@ -0,0 +1,118 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#include "ThingViews.h"
+#include "App.h"
+
+#include <cbang/String.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/JSON.h>
+
+using namespace std;
+using namespace cb;
+using namespace Buildbotics;
+
+
+bool ThingViews::View::operator<(const View &o) const {
+  if (owner != o.owner) return owner < o.owner;
+  if (name != o.name) return name < o.name;
+  return user < o.user;
+}
+
+
+ThingViews::ThingViews(App &app) :
+  app(app), recorded(0), duplicates(0), flushes(0) {}
+
+
+void ThingViews::init() {
+  flushEvent = app.getEventBase().newEvent(this, &ThingViews::flushEventCB);
+  flushEvent->add(app.getThingViewsFlushPeriod());
+}
+
+
+void ThingViews::add(const string &owner, const string &name,
+                     const string &user) {
+  if (views.insert(View(owner, name, user)).second) recorded++;
+  else duplicates++;
+
+  // Bound memory use under heavy traffic
+  if (10 * BATCH_SIZE <= views.size()) flush();
+}
+
+
+void ThingViews::flush() {
+  if (views.empty()) return;
+
+  DBQueue &queue = app.getDBQueue();
+  views_t::iterator it = views.begin();
+
+  while (it != views.end()) {
+    SmartPointer<JSON::Value> dict = new JSON::Dict;
+    string rows;
+
+    for (unsigned i = 0; i < BATCH_SIZE && it != views.end(); i++, it++) {
+      string n = String(i);
+      dict->insert("o" + n, it->owner);
+      dict->insert("n" + n, it->name);
+      dict->insert("u" + n, it->user);
+
+      if (i) rows += " UNION ALL ";
+      rows += "SELECT GetThingID(%(o" + n + ")S, %(n" + n + ")S) id, %(u" +
+        n + ")S user";
+    }
+
+    // Views of unknown things are dropped, repeats are ignored
+    queue.push("INSERT IGNORE INTO thing_views (thing_id, user) "
+               "SELECT id, user FROM (" + rows + ") v WHERE id IS NOT null",
+               dict);
+  }
+
+  views.clear();
+  flushes++;
+
+  queue.push("CALL CountThingViews()");
+}
+
+
+void ThingViews::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("pending", views.size());
+  writer.insert("recorded", recorded);
+  writer.insert("duplicates", duplicates);
+  writer.insert("flushes", flushes);
+  writer.endDict();
+}
+
+
+void ThingViews::flushEventCB(Event::Event &e, int signal, unsigned flags) {
+  e.add(app.getThingViewsFlushPeriod());
+  flush();
+}
@@ -0,0 +1,90 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/SmartPointer.h>
+
+#include <string>
+#include <set>
+#include <cstdint>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {class Writer;}
+}
+
+
+namespace Buildbotics {
+  class App;
+
+  // Collects unique thing views and writes them to the DB in batches
+  class ThingViews {
+    App &app;
+
+    struct View {
+      std::string owner;
+      std::string name;
+      std::string user;
+
+      View(const std::string &owner, const std::string &name,
+           const std::string &user) : owner(owner), name(name), user(user) {}
+
+      bool operator<(const View &o) const;
+    };
+
+    typedef std::set<View> views_t;
+    views_t views;
+
+    cb::SmartPointer<cb::Event::Event> flushEvent;
+
+    // Stats
+    uint64_t recorded;
+    uint64_t duplicates;
+    uint64_t flushes;
+
+  public:
+    static const unsigned BATCH_SIZE = 1000;
+
+    ThingViews(App &app);
+
+    void init();
+
+    void add(const std::string &owner, const std::string &name,
+             const std::string &user);
+    void flush();
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    void flushEventCB(cb::Event::Event &e, int signal, unsigned flags);
+  };
+}
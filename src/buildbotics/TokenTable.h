@@ -0,0 +1,246 @@
+/******************************************************************************\
+
+                 This file is part of the Buildbotics Webserver.
+
+                Copyright (c) 2014-2015, Cauldron Development LLC
+                               All rights reserved.
+
+        The Buildbotics Webserver is free software: you can redistribute
+        it and/or modify it under the terms of the GNU General Public
+        License as published by the Free Software Foundation, either
+        version 2 of the License, or (at your option) any later version.
+
+        The Buildbotics Webserver is distributed in the hope that it will
+        be useful, but WITHOUT ANY WARRANTY; without even the implied
+        warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+        PURPOSE.  See the GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this software.  If not, see
+        <http://www.gnu.org/licenses/>.
+
+        In addition, BSD licensing may be granted on a case by case basis
+        by written permission from at least one of the copyright holders.
+        You may request written permission by emailing the authors.
+
+                For information regarding this software email:
+                               Joseph Coffland
+                        joseph@cauldrondevelopment.com
+
+\******************************************************************************/
+
+#pragma once
+
+#include <cbang/Exception.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace Buildbotics {
+  struct Token {
+    static const unsigned SIZE = 32;
+    char data[SIZE];
+
+    Token() {memset(data, 0, sizeof(data));}
+
+    Token(const std::string &s) {
+      unsigned len = s.length() < SIZE ? s.length() : SIZE;
+      memcpy(data, s.data(), len);
+      memset(data + len, 0, SIZE - len);
+    }
+
+    std::string toString() const
+    {return std::string(data, strnlen(data, SIZE));}
+
+    uint64_t hash() const {
+      // Tokens are base64 encoded signatures and so already well mixed
+      uint64_t h;
+      memcpy(&h, data, sizeof(h));
+      return h * 0x9e3779b97f4a7c15ULL;
+    }
+
+    bool operator==(const Token &o) const
+    {return !memcmp(data, o.data, SIZE);}
+  };
+
+
+  // Open addressing hash table for fixed size Tokens.  Keys are stored
+  // inline.  A parallel array of control bytes holding 7 bits of each key's
+  // hash is probed 16 slots at a time so most misses never touch the keys.
+  template <typename T>
+  class TokenTable {
+    enum {
+      GROUP = 16,
+      EMPTY = 0x80,
+      DELETED = 0xfe,
+    };
+
+    struct Slot {
+      Token key;
+      T value;
+    };
+
+    std::vector<uint8_t> ctrl;
+    std::vector<Slot> slots;
+    unsigned count;
+    unsigned deleted;
+
+  public:
+    TokenTable() : count(0), deleted(0) {}
+
+    unsigned size() const {return count;}
+    unsigned capacity() const {return slots.size();}
+    bool empty() const {return !count;}
+
+
+    void clear() {
+      ctrl.clear();
+      slots.clear();
+      count = deleted = 0;
+    }
+
+
+    T *find(const Token &key) {
+      int i = lookup(key);
+      return i < 0 ? 0 : &slots[i].value;
+    }
+
+
+    // Returns the value for key and true if it was inserted.  Pointers into
+    // the table are invalidated by insert().
+    std::pair<T *, bool> insert(const Token &key) {
+      int i = lookup(key);
+      if (0 <= i) return std::pair<T *, bool>(&slots[i].value, false);
+
+      // Keep load, including tombstones, under 7/8
+      if ((capacity() * 7) / 8 <= count + deleted)
+        rehash(capacity() / 2 <= count ? capacity() * 2 : capacity());
+
+      uint64_t h = key.hash();
+      unsigned mask = groups() - 1;
+      unsigned g = h1(h) & mask;
+
+      for (unsigned step = 1;; g = (g + step++) & mask) {
+        uint32_t bits = matchFree(g);
+
+        if (bits) {
+          unsigned j = g * GROUP + ctz(bits);
+          if (ctrl[j] == DELETED) deleted--;
+
+          ctrl[j] = h2(h);
+          slots[j].key = key;
+          count++;
+
+          return std::pair<T *, bool>(&slots[j].value, true);
+        }
+      }
+    }
+
+
+    bool erase(const Token &key) {
+      int i = lookup(key);
+      if (i < 0) return false;
+
+      // If the group already has an empty slot no probe sequence continues
+      // past it, so the slot can be emptied rather than marked deleted
+      if (matchEmpty(i / GROUP)) ctrl[i] = EMPTY;
+      else {
+        ctrl[i] = DELETED;
+        deleted++;
+      }
+
+      slots[i].value = T();
+      count--;
+
+      return true;
+    }
+
+  protected:
+    unsigned groups() const {return slots.size() / GROUP;}
+    static unsigned h1(uint64_t h) {return h >> 7;}
+    static uint8_t h2(uint64_t h) {return h & 0x7f;}
+    static unsigned ctz(uint32_t x) {return __builtin_ctz(x);}
+
+
+    // Bit i is set if slot i of group g has control byte c
+    uint32_t match(unsigned g, uint8_t c) const {
+      const uint8_t *p = &ctrl[g * GROUP];
+
+#ifdef __SSE2__
+      __m128i group = _mm_loadu_si128((const __m128i *)p);
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+
+#else
+      uint32_t bits = 0;
+      for (unsigned i = 0; i < GROUP; i++)
+        if (p[i] == c) bits |= 1 << i;
+      return bits;
+#endif
+    }
+
+
+    uint32_t matchEmpty(unsigned g) const {return match(g, EMPTY);}
+
+
+    // Empty or deleted, i.e. high bit set
+    uint32_t matchFree(unsigned g) const {
+      const uint8_t *p = &ctrl[g * GROUP];
+
+#ifdef __SSE2__
+      return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p));
+
+#else
+      uint32_t bits = 0;
+      for (unsigned i = 0; i < GROUP; i++)
+        if (p[i] & 0x80) bits |= 1 << i;
+      return bits;
+#endif
+    }
+
+
+    int lookup(const Token &key) const {
+      if (slots.empty()) return -1;
+
+      uint64_t h = key.hash();
+      uint8_t tag = h2(h);
+      unsigned mask = groups() - 1;
+      unsigned g = h1(h) & mask;
+
+      for (unsigned step = 1; step <= groups(); g = (g + step++) & mask) {
+        for (uint32_t bits = match(g, tag); bits; bits &= bits - 1) {
+          unsigned i = g * GROUP + ctz(bits);
+          if (slots[i].key == key) return i;
+        }
+
+        if (matchEmpty(g)) return -1;
+      }
+
+      return -1;
+    }
+
+
+    void rehash(unsigned newCapacity) {
+      if (newCapacity < GROUP) newCapacity = GROUP;
+
+      std::vector<uint8_t> oldCtrl(newCapacity, EMPTY);
+      std::vector<Slot> oldSlots(newCapacity);
+      oldCtrl.swap(ctrl);
+      oldSlots.swap(slots);
+      count = deleted = 0;
+
+      for (unsigned i = 0; i < oldSlots.size(); i++)
+        if (!(oldCtrl[i] & 0x80)) {
+          std::pair<T *, bool> result = insert(oldSlots[i].key);
+          if (!result.second) THROW("Duplicate key in TokenTable");
+          *result.first = oldSlots[i].value;
+        }
+    }
+  };
+}
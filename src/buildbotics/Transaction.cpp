@@ -32,6 +32,8 @@
 #include "Transaction.h"
 #include "App.h"
 #include "AWS4Post.h"
+#include "Compression.h"
+#include "Cursor.h"
 
 #include <cbang/event/Client.h>
 #include <cbang/event/Buffer.h>
@@ -50,6 +52,14 @@
 
 #include <mysql/mysqld_error.h>
 
+#include <event2/buffer.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 using namespace cb;
 using namespace Buildbotics;
@@ -58,16 +68,29 @@ using namespace Buildbotics;
 Transaction::Transaction(App &app, Event::RequestMethod method, const URI &uri,
                          const Version &version) :
   Request(method, uri, version), Event::OAuth2Login(app.getEventClient()),
-  app(app), jsonFields(0) {
+  app(app), jsonFields(0), downloadCount(false),
+  dbCallback(0), pipelineNext(0), pipelineMarker(false), cacheTTL(0),
+  etagged(false), flightCallback(0), eventWait(false), rowsOpen(false),
+  rowsDict(false), cursorRows(0), batchParent(0), batchNext(0) {
   LOG_DEBUG(5, "Transaction()");
 }
 
 
-Transaction::~Transaction() {LOG_DEBUG(5, "~Transaction()");}
+Transaction::~Transaction() {
+  LOG_DEBUG(5, "~Transaction()");
+
+  // Connections are released on EVENTDB_DONE, any left are in an unknown state
+  app.getDBPool().cancel(*this);
+  if (!db.isNull()) app.getDBPool().discard(db);
+
+  if (!flightKey.empty()) app.getSingleFlight().leave(flightKey, *this);
+  if (eventWait) app.getEventBus().leave(*this);
+}
 
 
 bool Transaction::lookupUser(bool skipAuthCheck) {
   if (!user.isNull()) return true;
+  if (batchParent) return false; // Looked up once by the batch
 
   // Get session
   string session = findCookie(app.getSessionCookieName());
@@ -115,6 +138,7 @@ User &Transaction::getUser() {
 
 
 string Transaction::getViewID() {
+  if (batchParent) return batchParent->getViewID();
   lookupUser();
 
   if (user.isNull()) {
@@ -149,6 +173,14 @@ void Transaction::authorize(const string &name) {
 }
 
 
+bool Transaction::canSeePrivate(const string &profile) {
+  // Owners, admins and moderators
+  return lookupUser() && user->isAuthenticated() &&
+    (user->getName() == profile ||
+     (user->getAuth() & (AuthFlags::AUTH_ADMIN | AuthFlags::AUTH_MOD)));
+}
+
+
 void Transaction::setAuthCookie() {
   string session = user->getSession();
   setCookie(app.getSessionCookieName(), session, "", "/");
@@ -171,10 +203,273 @@ bool Transaction::hasTag(const string &tag) const {
 }
 
 
+unsigned Transaction::getLimit() const {
+  return String::parseU32(getArgs()->getString("limit", "100"));
+}
+
+
+unsigned Transaction::getOffset() const {
+  return String::parseU32(getArgs()->getString("offset", "0"));
+}
+
+
+bool Transaction::getCursor(const string &kind, unsigned count,
+                            vector<string> &parts) const {
+  return Cursor::decode(kind, getArgs()->getString("cursor", ""), count,
+                        parts);
+}
+
+
+void Transaction::setNextCursor(const string &cursor) {
+  nextCursor = cursor;
+  if (!cursor.empty()) outSet("X-Next-Cursor", cursor);
+}
+
+
+bool Transaction::isAnonymous() {
+  if (batchParent) return batchParent->isAnonymous();
+  return findCookie(app.getSessionCookieName()).empty() &&
+    !inHas("Authorization");
+}
+
+
+string Transaction::getCacheKey() const {
+  const URI &uri = getURI();
+  string key = uri.getPath() + "?";
+
+  // Query arguments are sorted by name
+  for (auto it = uri.begin(); it != uri.end(); it++)
+    key += URI::encode(it->first) + "=" + URI::encode(it->second) + "&";
+
+  return key;
+}
+
+
+bool Transaction::replyCached(double ttl) {
+  etagged = true;
+  if (!app.getResponseCacheSize()) return false;
+
+  string key = getCacheKey();
+  const ResponseCache::Entry *entry = app.getResponseCache().lookup(key);
+
+  if (!entry) {
+    // Filled by returnReply() on success
+    cacheKey = key;
+    cacheTTL = ttl;
+    return false;
+  }
+
+  // Answered without a DB query
+  if (replyNotModified(entry->etag)) return true;
+
+  setNextCursor(entry->cursor);
+  setContentType("application/json");
+  send(entry->data);
+  compressReply();
+  reply();
+
+  return true;
+}
+
+
+void Transaction::compressReply() {
+  if (batchParent) return;
+
+  unsigned threshold = app.getCompressionThreshold();
+  evbuffer *buffer = getOutputBuffer().getBuffer();
+  if (!threshold || evbuffer_get_length(buffer) < threshold) return;
+
+  outSet("Vary", "Accept-Encoding");
+
+  if (inHas("Accept-Encoding") &&
+      Compression::acceptsGzip(inGet("Accept-Encoding"))) {
+    Compression::gzip(buffer, app.getCompressionLevel());
+    outSet("Content-Encoding", "gzip");
+
+    // A strong ETag must differ between encodings
+    if (!replyETag.empty()) outSet("ETag", ResponseCache::gzipETag(replyETag));
+  }
+}
+
+
+void Transaction::invalidateCache() {
+  JSON::ValuePtr args = parseArgs();
+
+  // File downloads
+  if (args->hasString("profile")) {
+    string thing = args->getString("thing", "");
+    app.getDownloads().invalidate
+      (Downloads::key(args->getString("profile"), thing));
+  }
+
+  // Load changes to searchable things and profiles and new events
+  if (args->hasString("profile") || args->hasString("thing")) {
+    app.getSearchIndex().sync();
+    app.getEventBus().sync();
+  }
+
+  if (!app.getResponseCacheSize()) return;
+
+  ResponseCache &cache = app.getResponseCache();
+
+  const char *profiles[] = {"profile", "user", "owner", 0};
+  for (unsigned i = 0; profiles[i]; i++)
+    if (args->hasString(profiles[i])) {
+      string path = "/api/profiles/" + args->getString(profiles[i]);
+      cache.invalidate(path + "?");
+      cache.invalidate(path + "/");
+    }
+
+  // Thing changes may show up in any listing
+  if (args->hasString("thing")) {
+    cache.invalidate("/api/things");
+    cache.invalidate("/api/tags");
+  }
+}
+
+
+void Transaction::pipeline(event_db_member_functor_t member, const string &s,
+                           const SmartPointer<JSON::Value> &dict) {
+  if (dbCallback) THROW("DB query already pending");
+  pipelined.push_back(Pipelined(member, s));
+  addPipelineArgs(dict);
+}
+
+
+void Transaction::addPipelineArgs(const SmartPointer<JSON::Value> &dict) {
+  if (dict.isNull()) return;
+  if (pipelineDict.isNull()) pipelineDict = new JSON::Dict;
+
+  // Statements are formatted together so they must agree on arguments
+  for (unsigned i = 0; i < dict->size(); i++) {
+    const string &key = dict->keyAt(i);
+
+    if (pipelineDict->has(key) &&
+        pipelineDict->get(key)->toString() != dict->get(i)->toString())
+      THROW("Conflicting pipelined query argument '" << key << "'");
+
+    pipelineDict->insert(key, dict->get(i));
+  }
+}
+
+
 void Transaction::query(event_db_member_functor_t member, const string &s,
                         const SmartPointer<JSON::Value> &dict) {
-  if (db.isNull()) db = app.getDBConnection();
-  db->query(this, member, s, dict);
+  if (dbCallback) THROW("DB query already pending");
+
+  string sql = s;
+  SmartPointer<JSON::Value> args = dict;
+
+  if (!pipelined.empty()) {
+    // Sent as one compound statement, one round trip.  A marker result set
+    // follows each pipelined statement's results.
+    sql = "BEGIN NOT ATOMIC ";
+    for (unsigned i = 0; i < pipelined.size(); i++)
+      sql += pipelined[i].sql + "; SELECT " + String(i) + " _pipeline; ";
+    sql += s + "; END";
+
+    addPipelineArgs(dict);
+    args = pipelineDict;
+    pipelineNext = 0;
+    pipelineMarker = false;
+  }
+
+  dbCallback = member;
+
+  // Batch items reuse the batch's connection
+  if (db.isNull() && batchParent && !batchParent->db.isNull()) {
+    db = batchParent->db;
+    batchParent->db.release();
+  }
+
+  if (db.isNull()) db = app.getDBPool().get();
+
+  if (db.isNull()) {
+    // Wait for a free connection
+    if (!app.getDBPool().wait(*this))
+      THROWX("Server busy, try again later", HTTP_SERVICE_UNAVAILABLE);
+
+    pendingQuery = sql;
+    pendingDict = args;
+    return;
+  }
+
+  db->query(this, &Transaction::dbEvent, sql, args);
+}
+
+
+bool Transaction::sharedQuery(event_db_member_functor_t member,
+                              const string &s,
+                              const SmartPointer<JSON::Value> &dict) {
+  flightKey = getCacheKey();
+
+  if (app.getSingleFlight().join(flightKey, *this)) {
+    // Kept in case the leader goes away, pipelined statements included
+    flightCallback = member;
+    flightQuery = s;
+    flightDict = dict;
+    flightPipelined.swap(pipelined);
+    flightPipelineDict = pipelineDict;
+    pipelined.clear();
+    pipelineDict.release();
+    return true;
+  }
+
+  query(member, s, dict);
+  return false;
+}
+
+
+void Transaction::completeFlight(Event::HTTPStatus status, const string &data) {
+  if (flightKey.empty()) return;
+
+  string key;
+  key.swap(flightKey);
+  app.getSingleFlight().complete(key, *this, status, data);
+}
+
+
+void Transaction::flightDone(Event::HTTPStatus status, const string &data,
+                             const string &cursor) {
+  flightKey.clear();
+  flightDict.release();
+  flightPipelined.clear();
+  flightPipelineDict.release();
+
+  try {
+    if (status == HTTP_OK) {
+      if (etagged && replyNotModified(ResponseCache::makeETag(data))) return;
+
+      setNextCursor(cursor);
+      setContentType("application/json");
+      send(data);
+      compressReply();
+      reply();
+
+    } else sendError(status, data);
+
+    return;
+  } CATCH_ERROR;
+
+  sendError(HTTP_INTERNAL_SERVER_ERROR);
+}
+
+
+void Transaction::retryFlight() {
+  flightKey.clear();
+
+  // Restore pipelined statements registered before joining the flight
+  pipelined.swap(flightPipelined);
+  pipelineDict = flightPipelineDict;
+  flightPipelined.clear();
+  flightPipelineDict.release();
+
+  try {
+    sharedQuery(flightCallback, flightQuery, flightDict);
+    return;
+  } CATCH_ERROR;
+
+  sendError(HTTP_INTERNAL_SERVER_ERROR);
 }
 
 
@@ -186,7 +481,7 @@ bool Transaction::pleaseLogin() {
 
 string Transaction::postFile(const std::string &path, const string &file,
                              const string &type, uint32_t minSize,
-                             uint32_t maxSize) {
+                             uint32_t maxSize, const string &acl) {
   // Create GUID
   Digest hash("sha256");
   hash.update(path);
@@ -198,7 +493,7 @@ string Transaction::postFile(const std::string &path, const string &file,
   string key = guid + "/" + file;
 
   // Create URLs
-  string uploadURL = "https://" + app.getAWSBucket() + ".s3.amazonaws.com/";
+  string uploadURL = app.getAWSS3URL() + "/";
   string fileURL = path + "/" + file;
 
   // Build POST
@@ -207,7 +502,7 @@ string Transaction::postFile(const std::string &path, const string &file,
 
   post.setLengthRange(minSize, maxSize);
   post.insert("Content-Type", type);
-  post.insert("acl", "public-read");
+  post.insert("acl", acl);
   post.insert("success_action_status", "201");
   post.addCondition("name", file);
   post.sign(app.getAWSID(), app.getAWSSecret());
@@ -229,6 +524,248 @@ string Transaction::postFile(const std::string &path, const string &file,
 }
 
 
+bool Transaction::replyIDs(const vector<uint32_t> &ids, const string &sql) {
+  if (ids.empty()) {
+    setContentType("application/json");
+    writer = getJSONWriter();
+    writer->beginList();
+    writer->endList();
+    writer.release();
+    reply();
+    return true;
+  }
+
+  string list;
+  for (unsigned i = 0; i < ids.size(); i++) {
+    if (i) list += ",";
+    list += String(ids[i]);
+  }
+
+  SmartPointer<JSON::Value> dict = new JSON::Dict;
+  dict->insert("ids", list);
+
+  sharedQuery(&Transaction::returnList, sql, dict);
+  return true;
+}
+
+
+namespace {
+  bool parseU64(const string &s, uint64_t &value) {
+    if (s.empty() || 19 < s.length()) return false;
+
+    value = 0;
+    for (unsigned i = 0; i < s.length(); i++) {
+      if (!isdigit(s[i])) return false;
+      value = value * 10 + (s[i] - '0');
+    }
+
+    return true;
+  }
+
+
+  // Returns 1 for a satisfiable range, -1 for an unsatisfiable one and 0 if
+  // the header should be ignored.  Only single ranges are supported.
+  int parseRange(const string &range, uint64_t size, uint64_t &offset,
+                 uint64_t &length) {
+    if (range.compare(0, 6, "bytes=") || range.find(',') != string::npos)
+      return 0;
+
+    string spec = String::trim(range.substr(6));
+    size_t dash = spec.find('-');
+    if (dash == string::npos) return 0;
+
+    string first = spec.substr(0, dash);
+    string last = spec.substr(dash + 1);
+    uint64_t start;
+    uint64_t end;
+
+    if (first.empty()) {
+      // Suffix range
+      if (!parseU64(last, end)) return 0;
+      if (!end || !size) return -1;
+      if (size < end) end = size;
+
+      offset = size - end;
+      length = end;
+      return 1;
+    }
+
+    if (!parseU64(first, start)) return 0;
+    if (size <= start) return -1;
+
+    if (last.empty()) end = size - 1;
+    else {
+      if (!parseU64(last, end)) return 0;
+      if (end < start) return 0;
+      if (size <= end) end = size - 1;
+    }
+
+    offset = start;
+    length = end - start + 1;
+    return 1;
+  }
+
+
+  // Returns the matching form of etag, plain or gzip, or an empty string
+  string matchETag(const string &header, const string &etag) {
+    vector<string> tags;
+    String::tokenize(header, tags, ", ");
+
+    string gz = ResponseCache::gzipETag(etag);
+
+    for (unsigned i = 0; i < tags.size(); i++) {
+      string tag = String::startsWith(tags[i], "W/") ? tags[i].substr(2) :
+        tags[i];
+
+      if (tag == "*" || tag == etag) return etag;
+      if (tag == gz) return gz;
+    }
+
+    return "";
+  }
+}
+
+
+bool Transaction::replyNotModified(const string &etag) {
+  if (batchParent) return false;
+  outSet("ETag", replyETag = etag);
+
+  string match = inHas("If-None-Match") ?
+    matchETag(inGet("If-None-Match"), etag) : string();
+  if (match.empty()) return false;
+
+  outSet("ETag", match);
+  getOutputBuffer().clear();
+  reply(HTTP_NOT_MODIFIED);
+  return true;
+}
+
+
+void Transaction::sendDownload(const Downloads::Entry &entry) {
+  if (batchParent)
+    return sendError(HTTP_BAD_REQUEST, "Downloads not allowed in a batch");
+
+  if (entry.isLocal) sendLocalFile(entry);
+
+  // Private files redirect to a short lived signed URL
+  else if (entry.isPrivate) redirect(app.getSignedURLs().get(entry.target));
+
+  else {
+    setCache(Time::SEC_PER_HOUR);
+    redirect(entry.target);
+  }
+}
+
+
+void Transaction::sendLocalFile(const Downloads::Entry &entry) {
+  string path = URI::decode(entry.target);
+
+  // Keys must not escape the file store
+  vector<string> parts;
+  String::tokenize(path, parts, "/");
+  if (parts.size() != 2 || path.find('\0') != string::npos)
+    return sendError(HTTP_NOT_FOUND, "File not found");
+
+  for (unsigned i = 0; i < parts.size(); i++)
+    if (parts[i] == "." || parts[i] == "..")
+      return sendError(HTTP_NOT_FOUND, "File not found");
+
+  // HEAD is answered from the size stored in the DB
+  bool head = getMethod() == HTTP_HEAD;
+  uint64_t size = entry.size;
+  int fd = -1;
+
+  if (!head || !size) {
+    string filename = app.getFileStore() + path;
+    fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+      if (fd != -1) close(fd);
+      return sendError(HTTP_NOT_FOUND, "File not found");
+    }
+
+    size = st.st_size;
+    if (head) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  // The GUID changes with every upload
+  string etag = "\"" + parts[0] + "-" + String(size) + "\"";
+
+  outSet("ETag", etag);
+  outSet("Accept-Ranges", "bytes");
+  if (!entry.isPrivate) setCache(Time::SEC_PER_HOUR);
+
+  if (inHas("If-None-Match") &&
+      matchETag(inGet("If-None-Match"), etag) == etag) {
+    if (fd != -1) close(fd);
+    reply(HTTP_NOT_MODIFIED);
+    return;
+  }
+
+  uint64_t offset = 0;
+  uint64_t length = size;
+  bool partial = false;
+
+  if (inHas("Range") && (!inHas("If-Range") || inGet("If-Range") == etag)) {
+    int ret = parseRange(inGet("Range"), size, offset, length);
+
+    if (ret < 0) {
+      if (fd != -1) close(fd);
+      outSet("Content-Range", "bytes */" + String(size));
+      return sendError(HTTP_REQUESTED_RANGE_NOT_SATISFIABLE,
+                       "Range not satisfiable");
+    }
+
+    partial = 0 < ret;
+  }
+
+  if (partial)
+    outSet("Content-Range", "bytes " + String(offset) + "-" +
+           String(offset + length - 1) + "/" + String(size));
+
+  string type = entry.type;
+  if (type.find('/') == string::npos) type = "application/octet-stream";
+  setContentType(type);
+
+  if (head) outSet("Content-Length", String(length));
+
+  else if (length) {
+    // The buffer takes ownership of fd and sends it with sendfile() when the
+    // connection allows it
+    if (evbuffer_add_file(getOutputBuffer().getBuffer(), fd, offset, length))
+      return sendError(HTTP_INTERNAL_SERVER_ERROR, "Failed to send file");
+
+  } else close(fd);
+
+  reply(partial ? HTTP_PARTIAL_CONTENT : HTTP_OK);
+}
+
+
+void Transaction::dbReady(const SmartPointer<MariaDB::EventDB> &db) {
+  this->db = db;
+
+  try {
+    db->query(this, &Transaction::dbEvent, pendingQuery, pendingDict);
+    pendingQuery.clear();
+    pendingDict.release();
+    return;
+
+  } CATCH_ERROR;
+
+  sendError(HTTP_INTERNAL_SERVER_ERROR);
+}
+
+
+void Transaction::reply(Event::HTTPStatus code) {
+  if (batchParent) batchParent->batchReply(*this, code);
+  else Request::reply(code);
+}
+
+
 void Transaction::sendError(Event::HTTPStatus code, const string &message) {
   // Release JSON writer
   writer.release();
@@ -242,6 +779,12 @@ void Transaction::sendError(Event::HTTPStatus code, const string &message) {
 }
 
 
+void Transaction::sendError(Event::HTTPStatus code) {
+  if (batchParent) sendError(code, "");
+  else Request::sendError(code);
+}
+
+
 void Transaction::processProfile(Event::Request &req,
                                  const SmartPointer<JSON::Value> &profile) {
   if (!profile.isNull())
@@ -273,6 +816,127 @@ void Transaction::processProfile(Event::Request &req,
 }
 
 
+bool Transaction::apiRoute() {
+  return app.getServer().getRouter().dispatch(*this);
+}
+
+
+bool Transaction::apiBatch() {
+  JSON::ValuePtr args = parseArgs();
+  if (!args->has("requests") || !args->get("requests")->isList())
+    THROWX("Expected a 'requests' list", HTTP_BAD_REQUEST);
+
+  JSON::ValuePtr requests = args->get("requests");
+  if (app.getBatchMax() < requests->size())
+    THROWX("Too many requests in batch, maximum is " << app.getBatchMax(),
+           HTTP_BAD_REQUEST);
+
+  for (unsigned i = 0; i < requests->size(); i++)
+    batchPaths.push_back(requests->getString(i));
+
+  // One user lookup for all items
+  lookupUser();
+
+  setContentType("application/json");
+  send("[");
+
+  batchEvent = app.getEventBase().newEvent(this, &Transaction::batchNextCB);
+  batchEvent->add(0);
+
+  return true;
+}
+
+
+void Transaction::batchReply(Transaction &item, Event::HTTPStatus code) {
+  string out = batchNext == 1 ? "{\"path\":" : ",{\"path\":";
+  const string &path = batchPaths[batchNext - 1];
+  RowWriter::appendString(out, path.data(), path.length());
+  out += ",\"status\":" + String((int)code);
+
+  const string &cursor = item.getNextCursor();
+  if (!cursor.empty()) {
+    out += ",\"next_cursor\":";
+    RowWriter::appendString(out, cursor.data(), cursor.length());
+  }
+
+  // Item bodies are moved, not copied, into the batch response
+  evbuffer *body = item.getOutputBuffer().getBuffer();
+  if (code == HTTP_OK) {
+    out += ",\"body\":";
+    if (!evbuffer_get_length(body)) out += "null";
+    send(out);
+    evbuffer_add_buffer(getOutputBuffer().getBuffer(), body);
+    send("}");
+
+  } else {
+    string message = item.getOutputBuffer().toString();
+    out += ",\"error\":";
+    RowWriter::appendString(out, message.data(), message.length());
+    send(out + "}");
+  }
+
+  // Run the next item once this one has unwound
+  batchEvent->add(0);
+}
+
+
+void Transaction::batchNextCB(Event::Event &e, int signal, unsigned flags) {
+  batchItem.release();
+
+  if (batchNext == batchPaths.size()) {
+    if (!db.isNull()) {
+      app.getDBPool().release(db);
+      db.release();
+    }
+
+    send("]");
+    compressReply();
+    reply();
+    return;
+  }
+
+  const string &path = batchPaths[batchNext++];
+
+  URI uri;
+  bool validURI = true;
+  try {
+    uri = URI(path);
+  } catch (const Exception &) {validURI = false;}
+
+  batchItem = new Transaction(app, HTTP_GET, uri, Version(1, 1));
+  Transaction &item = *batchItem;
+
+  // The item takes the batch's connection only if it runs a query
+  item.batchParent = this;
+  item.user = user;
+
+  try {
+    // Only API reads, logins and downloads need a real client
+    const string &itemPath = item.getURI().getPath();
+    if (!validURI) item.sendError(HTTP_BAD_REQUEST, "Invalid path");
+
+    else if (!String::startsWith(itemPath, "/api/") ||
+             (String::startsWith(itemPath, "/api/auth/") &&
+              itemPath != "/api/auth/user"))
+      item.sendError(HTTP_BAD_REQUEST, "Not allowed in a batch");
+
+    else if (!app.getServer().getRouter().dispatch(item))
+      item.sendError(HTTP_NOT_FOUND, "Invalid API method " + itemPath);
+
+    return;
+
+  } catch (const Exception &e) {
+    int code = e.getCode();
+    if (code < 400 || 600 <= code) code = HTTP_INTERNAL_SERVER_ERROR;
+    item.sendError((Event::HTTPStatus::enum_t)code, e.getMessage());
+    return;
+
+  } CATCH_ERROR;
+
+  item.sendError(HTTP_INTERNAL_SERVER_ERROR);
+}
+
+
 bool Transaction::apiAuthUser() {
   authorize();
 
@@ -327,8 +991,50 @@ bool Transaction::apiAuthLogout() {
 
 
 bool Transaction::apiGetInfo() {
+  if (replyCached(5 * Time::SEC_PER_MIN)) return true;
+
   jsonFields = "permissions licenses";
-  query(&Transaction::returnJSONFields, "CALL GetInfo()");
+  pipeline(&Transaction::returnJSONFields, "CALL GetPermissions()");
+  sharedQuery(&Transaction::returnJSONFields, "CALL GetLicenses()");
+  return true;
+}
+
+
+bool Transaction::apiGetStats() {
+  authorize(AuthFlags::AUTH_ADMIN);
+
+  setContentType("application/json");
+  writer = getJSONWriter();
+  writer->beginDict();
+  writer->insert("worker", app.getWorkerID());
+  writer->beginInsert("db");
+  app.getDBPool().write(*writer);
+  writer->beginInsert("sessions");
+  app.getSessionCache().write(*writer);
+  writer->beginInsert("users");
+  app.getUserManager().write(*writer);
+  writer->beginInsert("responses");
+  app.getResponseCache().write(*writer);
+  writer->beginInsert("flights");
+  app.getSingleFlight().write(*writer);
+  writer->beginInsert("db_queue");
+  app.getDBQueue().write(*writer);
+  writer->beginInsert("views");
+  app.getThingViews().write(*writer);
+  writer->beginInsert("downloads");
+  app.getDownloads().write(*writer);
+  writer->beginInsert("counters");
+  app.getCounters().write(*writer);
+  writer->beginInsert("signed_urls");
+  app.getSignedURLs().write(*writer);
+  writer->beginInsert("search");
+  app.getSearchIndex().write(*writer);
+  writer->beginInsert("events");
+  app.getEventBus().write(*writer);
+  writer->endDict();
+  writer.release();
+
+  reply();
   return true;
 }
 
@@ -341,6 +1047,24 @@ bool Transaction::apiGetPermissions() {
 
 bool Transaction::apiGetProfiles() {
   JSON::ValuePtr args = parseArgs();
+
+  vector<string> after;
+  getCursor("profiles", SearchIndex::CURSOR_SIZE, after);
+
+  SearchIndex &index = app.getSearchIndex();
+  if (index.isReady()) {
+    vector<uint32_t> ids;
+    string next;
+    index.findProfiles(args->getString("query", ""), after, getOffset(),
+                       getLimit(), ids, next);
+
+    if (!next.empty()) setNextCursor(Cursor::encode("profiles", next));
+    return replyIDs(ids, "CALL GetProfilesByIDList(%(ids)S)");
+  }
+
+  if (!after.empty())
+    THROWX("Search index loading, try again later", HTTP_SERVICE_UNAVAILABLE);
+
   query(&Transaction::returnList,
         "CALL FindProfiles(%(query)S, %(limit)u, %(offset)u)", args);
   return true;
@@ -397,10 +1121,14 @@ bool Transaction::apiPutProfile() {
 
 
 bool Transaction::apiGetProfile() {
+  // Logged in users are not cached but still get an ETag
+  etagged = true;
+  if (isAnonymous() && replyCached(30)) return true;
+
   jsonFields = "*profile things followers following starred badges events";
 
-  query(&Transaction::returnJSONFields, "CALL GetProfile(%(profile)S)",
-        parseArgs());
+  sharedQuery(&Transaction::returnJSONFields, "CALL GetProfile(%(profile)S)",
+              parseArgs());
 
   return true;
 }
@@ -477,10 +1205,30 @@ bool Transaction::apiUnfollow() {
 
 
 bool Transaction::apiGetThings() {
+  if (replyCached(30)) return true;
+
   JSON::ValuePtr args = parseArgs();
 
-  query(&Transaction::returnList,
-        "CALL FindThings(%(query)S, %(license)S, %(limit)u, %(offset)u)", args);
+  vector<string> after;
+  getCursor("things", SearchIndex::CURSOR_SIZE, after);
+
+  SearchIndex &index = app.getSearchIndex();
+  if (index.isReady()) {
+    vector<uint32_t> ids;
+    string next;
+    index.findThings(args->getString("query", ""),
+                     args->getString("license", ""), after, getOffset(),
+                     getLimit(), ids, next);
+
+    if (!next.empty()) setNextCursor(Cursor::encode("things", next));
+    return replyIDs(ids, "CALL GetThingsByIDList(%(ids)S)");
+  }
+
+  if (!after.empty())
+    THROWX("Search index loading, try again later", HTTP_SERVICE_UNAVAILABLE);
+
+  sharedQuery(&Transaction::returnList, "CALL FindThings(%(query)S, "
+              "%(license)S, %(limit)u, %(offset)u)", args);
   return true;
 }
 
@@ -495,12 +1243,23 @@ bool Transaction::apiThingAvailable() {
 bool Transaction::apiGetThing() {
   JSON::ValuePtr args = parseArgs();
 
-  args->insert("view_id", getViewID());
+  app.getThingViews().add(args->getString("profile"), args->getString("thing"),
+                          getViewID());
 
   jsonFields = "*thing files comments stars";
 
-  query(&Transaction::returnJSONFields,
-        "CALL GetThing(%(profile)S, %(thing)S, %(view_id)S)", args);
+  // Private files are listed to their owner only, so those responses are
+  // not shared
+  const char *sql = "CALL GetThing(%(profile)S, %(thing)S, %(private)b)";
+  bool owner = canSeePrivate(args->getString("profile"));
+  args->insertBoolean("private", owner);
+
+  if (owner) {
+    etagged = true;
+    query(&Transaction::returnJSONFields, sql, args);
+
+  } else if (!replyCached(30))
+    sharedQuery(&Transaction::returnJSONFields, sql, args);
 
   return true;
 }
@@ -670,8 +1429,29 @@ bool Transaction::apiDownvoteComment() {
 bool Transaction::apiDownloadFile() {
   JSON::ValuePtr args = parseArgs();
 
+  Downloads &downloads = app.getDownloads();
+  downloadKey =
+    Downloads::key(args->getString("profile"), args->getString("thing"),
+                   args->getString("file"), args->getString("size", "orig"));
+
+  // Downloads are counted in memory and flushed in batches
+  downloadCount = getMethod() == HTTP_GET &&
+    String::parseBool(args->getString("count", "false"));
+
+  // Private files may only be downloaded by their owner
+  bool owner = canSeePrivate(args->getString("profile"));
+  args->insertBoolean("private", owner);
+
+  const Downloads::Entry *entry = downloads.lookup(downloadKey);
+  if (entry && (!entry->isPrivate || owner)) {
+    if (downloadCount) downloads.count(entry->fileID);
+    sendDownload(*entry);
+    return true;
+  }
+
   query(&Transaction::download,
-        "CALL DownloadFile(%(profile)S, %(thing)S, %(file)S, %(count)b)", args);
+        "CALL DownloadFile(%(profile)S, %(thing)S, %(file)S, %(private)b)",
+        args);
 
   return true;
 }
@@ -718,7 +1498,9 @@ bool Transaction::apiUploadFile() {
   uint32_t size = args->getU32("size");
 
   // Write post data
-  path = postFile(path, file, type, size, size);
+  string acl =
+    args->getString("visibility", "") == "private" ? "private" : "public-read";
+  path = postFile(path, file, type, size, size, acl);
   args->insert("path", path);
 
   query(&Transaction::returnReply,
@@ -787,31 +1569,99 @@ bool Transaction::apiFileDown() {
 
 
 bool Transaction::apiGetTags() {
+  if (replyCached(Time::SEC_PER_MIN)) return true;
+
   JSON::ValuePtr args = parseArgs();
-  query(&Transaction::returnList, "CALL GetTags(%(limit)u)", args);
+  sharedQuery(&Transaction::returnList, "CALL GetTags(%(limit)u)", args);
   return true;
 }
 
 
 bool Transaction::apiGetTagThings() {
+  if (replyCached(30)) return true;
+
   JSON::ValuePtr args = parseArgs();
-  query(&Transaction::returnList,
-        "CALL FindThingsByTag(%(tag)S, %(limit)u, %(offset)u)", args);
+
+  vector<string> after;
+  if (getCursor("tag", 4, after)) {
+    args->insert("after_published", after[0]);
+    args->insert("after_stars", after[1]);
+    args->insert("after_created", after[2]);
+    args->insert("after_id", after[3]);
+  }
+
+  cursorKind = "tag";
+  sharedQuery(&Transaction::returnCursorList,
+              "CALL FindThingsByTag(%(tag)S, %(limit)u, %(offset)u, "
+              "%(after_published)S, %(after_stars)S, %(after_created)S, "
+              "%(after_id)S)", args);
   return true;
 }
 
 
 bool Transaction::apiGetLicenses() {
-  query(&Transaction::returnList, "CALL GetLicenses()");
+  if (replyCached(5 * Time::SEC_PER_MIN)) return true;
+
+  sharedQuery(&Transaction::returnList, "CALL GetLicenses()");
   return true;
 }
 
 
 bool Transaction::apiGetEvents() {
   JSON::ValuePtr args = parseArgs();
-  query(&Transaction::returnList, "CALL GetEvents(%(subject)S, %(action)S, "
-        "%(object_type)S, %(object)S, %(owner)S, %(following)b, %(since)S, "
-        "%(limit)u)", args);
+
+  vector<string> after;
+  if (getCursor("events", 1, after)) args->insert("before", after[0]);
+
+  cursorKind = "events";
+  query(&Transaction::returnCursorList, "CALL GetEvents(%(subject)S, "
+        "%(action)S, %(object_type)S, %(object)S, %(owner)S, %(following)b, "
+        "%(since)S, %(limit)u, %(before)S)", args);
+  return true;
+}
+
+
+bool Transaction::apiPollEvents() {
+  JSON::ValuePtr args = parseArgs();
+  EventBus &bus = app.getEventBus();
+
+  if (!bus.isReady())
+    THROWX("Events loading, try again later", HTTP_SERVICE_UNAVAILABLE);
+
+  EventBus::Filter filter;
+  filter.after = bus.getLastID();
+  if (args->hasString("after"))
+    try {
+      filter.after = String::parseU32(args->getString("after"));
+    } catch (const Exception &) {
+      THROWX("Invalid 'after' event ID", HTTP_BAD_REQUEST);
+    }
+
+  filter.subject = args->getString("subject", "");
+  String::tokenize(args->getString("action", ""), filter.actions, ",");
+  filter.limit = getLimit();
+  if (!filter.limit) THROWX("'limit' must be at least 1", HTTP_BAD_REQUEST);
+
+  EventBus::entries_t entries;
+  bus.find(filter, entries);
+  if (!entries.empty()) {
+    replyEvents(entries);
+    return true;
+  }
+
+  double timeout = app.getEventPollTimeout();
+  if (args->hasString("timeout"))
+    try {
+      timeout = max(0.0, min(timeout,
+                             String::parseDouble(args->getString("timeout"))));
+    } catch (const Exception &) {
+      THROWX("Invalid 'timeout'", HTTP_BAD_REQUEST);
+    }
+
+  // Replied to by the event bus
+  bus.wait(*this, filter, timeout);
+  eventWait = true;
+
   return true;
 }
 
@@ -828,6 +1678,68 @@ bool Transaction::notFound() {
 }
 
 
+void Transaction::dbEvent(MariaDB::EventDB::state_t state) {
+  event_db_member_functor_t member = dbCallback;
+
+  // Route result sets of pipelined statements to their own callbacks
+  if (pipelineNext < pipelined.size())
+    switch (state) {
+    case MariaDB::EventDB::EVENTDB_BEGIN_RESULT:
+      pipelineMarker = db->getFieldCount() == 1 &&
+        db->getField(0).getName() == "_pipeline";
+      // Fall through
+
+    case MariaDB::EventDB::EVENTDB_ROW:
+      if (pipelineMarker) return;
+      member = pipelined[pipelineNext].member;
+      break;
+
+    case MariaDB::EventDB::EVENTDB_END_RESULT:
+      if (pipelineMarker) {
+        pipelineMarker = false;
+        pipelineNext++;
+        return;
+      }
+
+      member = pipelined[pipelineNext].member;
+      break;
+
+    default: break;
+    }
+
+  switch (state) {
+  case MariaDB::EventDB::EVENTDB_RETRY:
+    pipelineNext = 0;
+    pipelineMarker = false;
+    break;
+
+  case MariaDB::EventDB::EVENTDB_DONE:
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    pipelined.clear();
+    pipelineDict.release();
+    break;
+
+  default: break;
+  }
+
+  if (state == MariaDB::EventDB::EVENTDB_DONE) {
+    dbCallback = 0;
+    if (getMethod() & (HTTP_PUT | HTTP_POST | HTTP_DELETE)) invalidateCache();
+  }
+
+  (this->*member)(state);
+
+  // Return the connection to the pool unless another query was started
+  if (state == MariaDB::EventDB::EVENTDB_DONE && !dbCallback &&
+      !db.isNull()) {
+    // Batch items hand the connection on to the next item
+    if (batchParent) batchParent->db = db;
+    else app.getDBPool().release(db);
+    db.release();
+  }
+}
+
+
 string Transaction::nextJSONField() {
   if (!jsonFields) return "";
 
@@ -848,12 +1760,26 @@ void Transaction::download(MariaDB::EventDB::state_t state) {
     break;
 
   case MariaDB::EventDB::EVENTDB_DONE:
-    setCache(Time::SEC_PER_HOUR);
-    redirect(redirectTo);
+    if (!downloadKey.empty() && downloadEntry.fileID) {
+      Downloads &downloads = app.getDownloads();
+      downloads.insert(downloadKey, downloadEntry);
+      if (downloadCount) downloads.count(downloadEntry.fileID);
+    }
+
+    sendDownload(downloadEntry);
     break;
 
   case MariaDB::EventDB::EVENTDB_ROW: {
+    Downloads::Entry &entry = downloadEntry;
+    unsigned fields = db->getFieldCount();
+
     string path = db->getString(0);
+    string type = 1 < fields ? db->getString(1) : "";
+    if (2 < fields) entry.fileID = db->getU64(2);
+    if (3 < fields) entry.isPrivate = db->getString(3) == "private";
+    if (4 < fields) entry.size = db->getU64(4);
+    entry.type = type;
+
     string size = getArgs()->getString("size", "orig");
 
     // Is absolute URL?
@@ -876,21 +1802,21 @@ void Transaction::download(MariaDB::EventDB::state_t state) {
       } else if (url.getHost().find("google") != string::npos)
         url["sz"] = pixels;
 
-      redirectTo = url.toString();
+      entry.target = url.toString();
       break;
     }
 
-    string type = 1 < db->getFieldCount() ? db->getString(1) : "";
-
     // Is resizable image?
-    if (size != "orig" &&
+    if (size != "orig" && !entry.isPrivate &&
         (type == "image/png" || type == "image/gif" || type == "image/jpeg" ||
          type == "avatar")) {
-      redirectTo = app.getImageHost() + path + "?size=" + size;
+      entry.target = app.getImageHost() + path + "?size=" + size;
       break;
     }
 
-    redirectTo = "//" + app.getAWSBucket() + ".s3.amazonaws.com" + path;
+    entry.isLocal = !app.getFileStore().empty();
+    if (entry.isPrivate || entry.isLocal) entry.target = path;
+    else entry.target = app.getAWSS3URL() + path;
     break;
   }
 
@@ -964,25 +1890,63 @@ void Transaction::returnOK(MariaDB::EventDB::state_t state) {
 
 
 void Transaction::returnList(MariaDB::EventDB::state_t state) {
-  if (state != MariaDB::EventDB::EVENTDB_ROW) returnJSON(state);
+  switch (state) {
+  case MariaDB::EventDB::EVENTDB_ROW: rows.writeRow(*db); break;
+
+  case MariaDB::EventDB::EVENTDB_BEGIN_RESULT:
+    setContentType("application/json");
+    rows.begin(*db);
+    rows.append('[');
+    break;
 
+  case MariaDB::EventDB::EVENTDB_END_RESULT:
+    rows.append(']');
+    rows.flush(getOutputBuffer().getBuffer());
+    break;
+
+  case MariaDB::EventDB::EVENTDB_RETRY:
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    rows.clear();
+    // Fall through
+
+  default: return returnReply(state);
+  }
+}
+
+
+void Transaction::replyEvents(const EventBus::entries_t &entries) {
+  eventWait = false;
+
+  setContentType("application/json");
+  writer = getJSONWriter();
+  EventBus::write(*writer, entries);
+  writer.release();
+
+  reply();
+}
+
+
+void Transaction::returnCursorList(MariaDB::EventDB::state_t state) {
   switch (state) {
   case MariaDB::EventDB::EVENTDB_ROW:
-    writer->beginAppend();
-
-    if (db->getFieldCount() == 1) db->writeField(*writer, 0);
-    else db->writeRowDict(*writer);
+    rows.writeRow(*db);
+    cursorKey = db->getString(db->getFieldCount() - 1);
+    cursorRows++;
     break;
 
   case MariaDB::EventDB::EVENTDB_BEGIN_RESULT:
-    writer->beginList();
+    // The last column is the row's sort key
+    setContentType("application/json");
+    rows.begin(*db, db->getFieldCount() - 1);
+    rows.append('[');
     break;
 
-  case MariaDB::EventDB::EVENTDB_END_RESULT:
-    writer->endList();
-    break;
+  case MariaDB::EventDB::EVENTDB_DONE:
+    if (cursorRows && cursorRows == getLimit())
+      setNextCursor(Cursor::encode(cursorKind, cursorKey));
+    // Fall through
 
-  default: break;
+  default: return returnList(state);
   }
 }
 
@@ -1043,44 +2007,51 @@ void Transaction::returnJSON(MariaDB::EventDB::state_t state) {
 void Transaction::returnJSONFields(MariaDB::EventDB::state_t state) {
   switch (state) {
   case MariaDB::EventDB::EVENTDB_ROW:
-    if (writer->inDict()) db->insertRow(*writer, 0, -1, false);
-
-    else if (db->getFieldCount() == 1) {
-      writer->beginAppend();
-      db->writeField(*writer, 0);
-
-    } else {
-      writer->appendDict();
-      db->insertRow(*writer, 0, -1, false);
-      writer->endDict();
-    }
+    if (rowsDict) rows.writeFields(*db);
+    else rows.writeRow(*db);
     break;
 
   case MariaDB::EventDB::EVENTDB_BEGIN_RESULT: {
     setContentType("application/json");
-    if (writer.isNull()) {
-      writer = getJSONWriter();
-      writer->beginDict();
-    }
+    rows.append(rowsOpen ? ',' : '{');
+    rowsOpen = true;
 
     string field = nextJSONField();
     if (field.empty()) THROW("Unexpected result set");
-    if (field[0] == '*') writer->insertDict(field.substr(1));
-    else writer->insertList(field);
+    rowsDict = field[0] == '*';
+    if (rowsDict) field = field.substr(1);
+
+    rows.appendString(field.data(), field.length());
+    rows.append(rowsDict ? ":{" : ":[");
+    rows.begin(*db);
     break;
   }
 
   case MariaDB::EventDB::EVENTDB_END_RESULT:
-    if (writer->inList()) writer->endList();
-    else writer->endDict();
+    rows.append(rowsDict ? '}' : ']');
     break;
 
   case MariaDB::EventDB::EVENTDB_DONE:
-    if (!writer.isNull()) writer->endDict();
-    // Fall through
+    if (rowsOpen) {
+      rows.append('}');
+      rows.flush(getOutputBuffer().getBuffer());
+      rowsOpen = false;
+    }
+    break;
 
-  default: return returnReply(state);
+  case MariaDB::EventDB::EVENTDB_RETRY:
+  case MariaDB::EventDB::EVENTDB_ERROR:
+    rows.clear();
+    rowsOpen = false;
+    break;
+
+  default: break;
   }
+
+  if (state != MariaDB::EventDB::EVENTDB_ROW &&
+      state != MariaDB::EventDB::EVENTDB_BEGIN_RESULT &&
+      state != MariaDB::EventDB::EVENTDB_END_RESULT)
+    returnReply(state);
 }
 
 
@@ -1088,6 +2059,20 @@ void Transaction::returnReply(MariaDB::EventDB::state_t state) {
   switch (state) {
   case MariaDB::EventDB::EVENTDB_DONE:
     writer.release();
+
+    if (!cacheKey.empty() || !flightKey.empty() || etagged) {
+      string data = getOutputBuffer().toString();
+      string etag = etagged ? ResponseCache::makeETag(data) : string();
+
+      if (!cacheKey.empty())
+        app.getResponseCache().insert(cacheKey, data, etag, cacheTTL,
+                                      nextCursor);
+      completeFlight(HTTP_OK, data);
+
+      if (etagged && replyNotModified(etag)) break;
+    }
+
+    compressReply();
     reply();
     break;
 
@@ -1106,6 +2091,7 @@ void Transaction::returnReply(MariaDB::EventDB::state_t state) {
     }
 
     LOG_ERROR("DB:" << db->getErrorNumber() << ": " << db->getError());
+    completeFlight(error, db->getError());
     sendError(error, db->getError());
     THROWX(db->getError(), error);
 
@@ -33,15 +33,22 @@
 
 
 #include "AuthFlags.h"
+#include "DBPool.h"
+#include "Downloads.h"
+#include "EventBus.h"
+#include "RowWriter.h"
 
 #include <cbang/event/Request.h>
 #include <cbang/event/RequestMethod.h>
 #include <cbang/event/OAuth2Login.h>
 #include <cbang/db/maria/EventDB.h>
 
+#include <vector>
+
 
 namespace cb {
   class OAuth2Login;
+  namespace Event {class Event;}
   namespace MariaDB {class EventDB;}
   namespace JSON {
     class Writer;
@@ -55,13 +62,66 @@ namespace Buildbotics {
   class User;
   class AWS4Post;
 
-  class Transaction : public cb::Event::Request, public cb::Event::OAuth2Login {
+  class Transaction :
+    public cb::Event::Request, public cb::Event::OAuth2Login,
+    public DBPool::Waiter {
     App &app;
     cb::SmartPointer<User> user;
     cb::SmartPointer<cb::MariaDB::EventDB> db;
     cb::SmartPointer<cb::JSON::Writer> writer;
     const char *jsonFields;
-    std::string redirectTo;
+    std::string downloadKey;
+    Downloads::Entry downloadEntry;
+    bool downloadCount;
+
+    cb::MariaDB::EventDB::Callback<Transaction>::member_t dbCallback;
+    std::string pendingQuery;
+    cb::SmartPointer<cb::JSON::Value> pendingDict;
+
+    // Statements sent ahead of the next query, each with its own callback
+    struct Pipelined {
+      cb::MariaDB::EventDB::Callback<Transaction>::member_t member;
+      std::string sql;
+
+      Pipelined(cb::MariaDB::EventDB::Callback<Transaction>::member_t member,
+                const std::string &sql) : member(member), sql(sql) {}
+    };
+
+    std::vector<Pipelined> pipelined;
+    cb::SmartPointer<cb::JSON::Value> pipelineDict;
+    unsigned pipelineNext;
+    bool pipelineMarker;
+
+    std::string cacheKey;
+    double cacheTTL;
+    bool etagged;
+    std::string replyETag;
+
+    std::string flightKey;
+    cb::MariaDB::EventDB::Callback<Transaction>::member_t flightCallback;
+    std::string flightQuery;
+    cb::SmartPointer<cb::JSON::Value> flightDict;
+    std::vector<Pipelined> flightPipelined;
+    cb::SmartPointer<cb::JSON::Value> flightPipelineDict;
+
+    bool eventWait;
+
+    RowWriter rows;
+    bool rowsOpen;
+    bool rowsDict;
+
+    std::string cursorKind;
+    unsigned cursorRows;
+    std::string cursorKey;
+    std::string nextCursor;
+
+    // Batch requests run their items one at a time on this connection and
+    // user.  Items reply to the batch rather than to a client.
+    Transaction *batchParent;
+    cb::SmartPointer<Transaction> batchItem;
+    std::vector<std::string> batchPaths;
+    unsigned batchNext;
+    cb::SmartPointer<cb::Event::Event> batchEvent;
 
   public:
     Transaction(App &app, cb::Event::RequestMethod method, const cb::URI &uri,
@@ -74,38 +134,77 @@ namespace Buildbotics {
     void authorize(unsigned flags = AuthFlags::AUTH_NONE);
     void authorize(unsigned flags, const std::string &name);
     void authorize(const std::string &name);
+    bool canSeePrivate(const std::string &profile);
 
     void setAuthCookie();
     void clearAuthCookie(uint64_t expires = 0);
 
     bool hasTag(const std::string &tag) const;
+    unsigned getLimit() const;
+    unsigned getOffset() const;
+    bool getCursor(const std::string &kind, unsigned count,
+                   std::vector<std::string> &parts) const;
+    const std::string &getNextCursor() const {return nextCursor;}
+    void setNextCursor(const std::string &cursor);
+
+    bool isAnonymous();
+    std::string getCacheKey() const;
+    bool replyCached(double ttl);
+    bool replyNotModified(const std::string &etag);
+    void compressReply();
+    void invalidateCache();
 
     typedef typename cb::MariaDB::EventDB::Callback<Transaction>::member_t
     event_db_member_functor_t;
+    void pipeline(event_db_member_functor_t member, const std::string &s,
+                  const cb::SmartPointer<cb::JSON::Value> &dict = 0);
+    void addPipelineArgs(const cb::SmartPointer<cb::JSON::Value> &dict);
     void query(event_db_member_functor_t member, const std::string &s,
                const cb::SmartPointer<cb::JSON::Value> &dict = 0);
+    bool sharedQuery(event_db_member_functor_t member, const std::string &s,
+                     const cb::SmartPointer<cb::JSON::Value> &dict = 0);
+    void completeFlight(cb::Event::HTTPStatus status, const std::string &data);
+    void flightDone(cb::Event::HTTPStatus status, const std::string &data,
+                    const std::string &cursor);
+    void retryFlight();
 
     bool apiError(int status, const std::string &msg);
     bool pleaseLogin();
 
     std::string postFile(const std::string &key, const std::string &file,
                          const std::string &type, uint32_t minSize,
-                         uint32_t maxSize);
+                         uint32_t maxSize,
+                         const std::string &acl = "public-read");
+    bool replyIDs(const std::vector<uint32_t> &ids, const std::string &sql);
+    void sendDownload(const Downloads::Entry &entry);
+    void sendLocalFile(const Downloads::Entry &entry);
+
+    // From DBPool::Waiter
+    void dbReady(const cb::SmartPointer<cb::MariaDB::EventDB> &db);
 
     // From cb::Event::Request
+    void reply(cb::Event::HTTPStatus code = cb::Event::HTTPStatus::HTTP_OK);
     using cb::Event::Request::sendError;
     void sendError(cb::Event::HTTPStatus code, const std::string &message);
+    void sendError(cb::Event::HTTPStatus code);
+
+    void batchReply(Transaction &item, cb::Event::HTTPStatus code);
+    void batchNextCB(cb::Event::Event &e, int signal, unsigned flags);
 
     // From cb::Event::OAuth2Login
     void processProfile(cb::Event::Request &req,
                         const cb::SmartPointer<cb::JSON::Value> &profile);
 
     // Event::WebServer request callbacks
+    bool apiRoute();
+
     bool apiAuthUser();
     bool apiAuthLogin();
     bool apiAuthLogout();
 
+    bool apiBatch();
     bool apiGetInfo();
+    bool apiGetStats();
 
     bool apiGetPermissions();
 
@@ -159,6 +258,7 @@ namespace Buildbotics {
     bool apiGetLicenses();
 
     bool apiGetEvents();
+    bool apiPollEvents();
 
     bool apiNotFound();
     bool notFound();
@@ -166,12 +266,16 @@ namespace Buildbotics {
     // MariaDB::EventDB callbacks
     std::string nextJSONField();
 
+    void dbEvent(cb::MariaDB::EventDB::state_t state);
+
     void download(cb::MariaDB::EventDB::state_t state);
     void authUser(cb::MariaDB::EventDB::state_t state);
     void login(cb::MariaDB::EventDB::state_t state);
     void registration(cb::MariaDB::EventDB::state_t state);
     void returnOK(cb::MariaDB::EventDB::state_t state);
     void returnList(cb::MariaDB::EventDB::state_t state);
+    void returnCursorList(cb::MariaDB::EventDB::state_t state);
+    void replyEvents(const EventBus::entries_t &entries);
     void returnBool(cb::MariaDB::EventDB::state_t state);
     void returnU64(cb::MariaDB::EventDB::state_t state);
     void returnS64(cb::MariaDB::EventDB::state_t state);
@@ -88,18 +88,35 @@ string User::updateSession() {
   ctx.setRSAPadding(KeyContext::NO_PADDING);
 
   session = Base64('=', '-', '_', 0).encode(ctx.sign(state));
+  app.getSessionCache().countRSA();
+
+  // Cache the new session so it need not be verified again
+  if (isAuthenticated()) cacheSession(session);
 
   return getToken();
 }
 
 
 void User::decodeSession(const string &session) {
+  SessionCache &cache = app.getSessionCache();
+  SessionCache::Entry entry;
+
+  if (cache.lookup(session, entry)) {
+    expires = entry.expires;
+    provider = entry.provider;
+    id = entry.id;
+    name = entry.name;
+    auth = entry.auth;
+    return;
+  }
+
   KeyContext ctx(app.getPrivateKey());
 
   ctx.verifyRecoverInit();
   ctx.setRSAPadding(KeyContext::NO_PADDING);
 
   string state = ctx.verifyRecover(Base64('=', '-', '_', 0).decode(session));
+  cache.countRSA();
   LOG_DEBUG(5, "state = " << String::trim(state));
   JSON::ValuePtr data = JSON::Reader(StringInputSource(state)).parse();
 
@@ -110,6 +127,22 @@ void User::decodeSession(const string &session) {
   id = data->getString("id");
   name = data->getString("name", "");
   auth = data->getU64("auth", 0);
+
+  cacheSession(session);
+}
+
+
+void User::cacheSession(const string &session) const {
+  SessionCache::Entry entry;
+
+  entry.session = session;
+  entry.expires = expires;
+  entry.provider = provider;
+  entry.id = id;
+  entry.name = name;
+  entry.auth = auth;
+
+  app.getSessionCache().insert(entry);
 }
 
 
@@ -66,6 +66,7 @@ namespace Buildbotics {
     std::string updateSession();
     void decodeSession(const std::string &session);
 
+    uint64_t getExpires() const {return expires;}
     bool hasExpired() const;
     bool isExpiring() const;
 
@@ -82,5 +83,8 @@ namespace Buildbotics {
     uint64_t getAuth() const {return auth;}
 
     bool isAuthenticated() const {return !provider.empty() && !id.empty();}
+
+  protected:
+    void cacheSession(const std::string &session) const;
   };
 }
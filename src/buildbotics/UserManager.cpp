@@ -30,29 +30,47 @@
 \******************************************************************************/
 
 #include "UserManager.h"
+#include "App.h"
 
 #include <cbang/log/Logger.h>
 #include <cbang/Catch.h>
+#include <cbang/time/Time.h>
+#include <cbang/event/Event.h>
+#include <cbang/json/Writer.h>
 
 using namespace std;
 using namespace cb;
 using namespace Buildbotics;
 
 
-UserManager::UserManager(App &app) : app(app) {
-  // TODO register cleanup event
+UserManager::UserManager(App &app) : app(app), expired(0), evicted(0) {}
+
+
+void UserManager::init() {
+  app.getEventBase().newEvent(this, &UserManager::cleanupEvent)
+    ->add(app.getUserCleanupPeriod());
 }
 
 
 void UserManager::cleanup() {
-  // TODO clean up expired Users
+  uint64_t now = Time::now();
+  unsigned count = 0;
+
+  // Only visits expired Users
+  while (!expires.empty() && expires.begin()->first < now) {
+    remove(expires.begin()->second);
+    count++;
+  }
+
+  expired += count;
+  if (count) LOG_DEBUG(3, "Removed " << count << " expired users");
 }
 
 
 SmartPointer<User> UserManager::create() {
   SmartPointer<User> user = new User(app);
 
-  if (!users.insert(users_t::value_type(user->getToken(), user)).second)
+  if (!add(user->getToken(), user))
     THROW("User token already exists: " << user->getToken());
 
   return user;
@@ -60,10 +78,14 @@ SmartPointer<User> UserManager::create() {
 
 
 SmartPointer<User> UserManager::get(const string &session) {
-  string token = session.substr(0, 32);
+  Token token(session);
 
-  users_t::iterator it = users.find(token);
-  if (it != users.end()) return it->second;
+  Entry *entry = users.find(token);
+  if (entry) {
+    // Move to front of LRU
+    lru.splice(lru.begin(), lru, entry->lru);
+    return entry->user;
+  }
 
   // Decode session and create user if valid
   try {
@@ -72,7 +94,8 @@ SmartPointer<User> UserManager::get(const string &session) {
     // TODO look up user profile in DB
 
     // Add user
-    return users.insert(users_t::value_type(token, user)).first->second;
+    add(token, user);
+    return user;
 
   } CATCH_ERROR;
 
@@ -85,9 +108,55 @@ void UserManager::updateSession(const SmartPointer<User> &user) {
   string newToken = user->updateSession();
 
   // Insert user under new token
-  if (!users.insert(users_t::value_type(newToken, user)).second)
+  if (!add(newToken, user))
     THROW("User token already exists " << newToken);
 
   // Remove user under old token
-  users.erase(oldToken);
+  remove(oldToken);
+}
+
+
+void UserManager::write(JSON::Writer &writer) const {
+  writer.beginDict();
+  writer.insert("size", users.size());
+  writer.insert("expired", expired);
+  writer.insert("evicted", evicted);
+  writer.endDict();
+}
+
+
+bool UserManager::add(const Token &token, const SmartPointer<User> &user) {
+  if (users.find(token)) return false;
+
+  // Enforce size limit, least recently used first
+  while (!lru.empty() && app.getUserCacheSize() <= users.size()) {
+    remove(lru.back());
+    evicted++;
+  }
+
+  Entry &entry = *users.insert(token).first;
+  entry.user = user;
+  entry.lru = lru.insert(lru.begin(), token);
+  entry.expires =
+    expires.insert(expires_t::value_type(user->getExpires(), token));
+
+  return true;
+}
+
+
+void UserManager::remove(const Token &token) {
+  Entry *entry = users.find(token);
+  if (!entry) return;
+
+  // Copy, token may refer to an LRU or expiration entry
+  Token key = token;
+  lru.erase(entry->lru);
+  expires.erase(entry->expires);
+  users.erase(key);
+}
+
+
+void UserManager::cleanupEvent(Event::Event &e, int signal, unsigned flags) {
+  e.add(app.getUserCleanupPeriod());
+  cleanup();
 }
@@ -33,9 +33,16 @@
 
 
 #include "User.h"
+#include "TokenTable.h"
 
 #include <string>
 #include <map>
+#include <list>
+
+namespace cb {
+  namespace Event {class Event;}
+  namespace JSON {class Writer;}
+}
 
 
 namespace Buildbotics {
@@ -44,16 +51,40 @@ namespace Buildbotics {
   class UserManager {
     App &app;
 
-    typedef std::map<std::string, cb::SmartPointer<User> > users_t;
+    typedef std::list<Token> lru_t;
+    lru_t lru; // Most recently used first
+
+    typedef std::multimap<uint64_t, Token> expires_t;
+    expires_t expires;
+
+    struct Entry {
+      cb::SmartPointer<User> user;
+      lru_t::iterator lru;
+      expires_t::iterator expires;
+    };
+
+    typedef TokenTable<Entry> users_t;
     users_t users;
 
+    uint64_t expired;
+    uint64_t evicted;
+
   public:
     UserManager(App &app);
 
+    void init();
     void cleanup();
 
     cb::SmartPointer<User> create();
     cb::SmartPointer<User> get(const std::string &session);
     void updateSession(const cb::SmartPointer<User> &user);
+
+    void write(cb::JSON::Writer &writer) const;
+
+  protected:
+    bool add(const Token &token, const cb::SmartPointer<User> &user);
+    void remove(const Token &token);
+
+    void cleanupEvent(cb::Event::Event &e, int signal, unsigned flags);
   };
 }
@@ -319,14 +319,6 @@ BEGIN
 END;
 
 
--- Info
-CREATE PROCEDURE GetInfo()
-BEGIN
-  CALL GetPermissions();
-  CALL GetLicenses();
-END;
-
-
 -- Permissions
 CREATE PROCEDURE GetPermissions()
 BEGIN
@@ -410,8 +402,14 @@ BEGIN
   CALL GetFollowingByID(_profile_id);
   CALL GetStarredThingsByID(_profile_id);
   CALL GetBadgesByID(_profile_id);
-  CALL GetEventsByID(_profile_id, null, null, null, false,
-    now() - INTERVAL 1 month, null);
+
+  -- Like GetEventsByID() but without the cursor sort key
+  SELECT FormatTS(ts) ts, subject, action, object_type, path
+    FROM events
+    WHERE subject_id = _profile_id AND now() - INTERVAL 1 month <= ts AND
+      path IS NOT null
+    ORDER BY id DESC
+    LIMIT 100;
 END;
 
 
@@ -711,7 +709,7 @@ END;
 
 
 CREATE PROCEDURE GetThing(IN _owner VARCHAR(64), IN _name VARCHAR(64),
-  IN _user VARCHAR(64))
+  IN _private BOOL)
 BEGIN
   DECLARE _owner_id INT;
   DECLARE _thing_id INT;
@@ -724,11 +722,6 @@ BEGIN
      SET MESSAGE_TEXT = 'Thing not found';
   END IF;
 
-  -- Views
-  INSERT INTO thing_views (thing_id, user)
-    VALUES (_thing_id, _user)
-    ON DUPLICATE KEY UPDATE thing_id = thing_id;
-
   -- Thing
   SELECT t.name, _owner owner, o.points owner_points, t.type, t.title,
     IF(t.published IS null, null, FormatTS(t.published)) published,
@@ -755,7 +748,8 @@ BEGIN
   SELECT f.name, type, FormatTS(f.created) created, downloads, caption,
     visibility, space size, GetFileURL(_owner, _name, f.name) url
     FROM files f
-    WHERE f.thing_id = _thing_id AND f.confirmed
+    WHERE f.thing_id = _thing_id AND f.confirmed AND
+      (_private OR f.visibility != 'private')
     ORDER BY f.position, f.created;
 
   -- Comments
@@ -888,7 +882,8 @@ END;
 
 
 CREATE PROCEDURE FindThingsByTag(IN _tags VARCHAR(256), IN _limit INT,
-  IN _offset INT)
+  IN _offset INT, IN _after_published BOOLEAN, IN _after_stars INT,
+  IN _after_created BIGINT, IN _after_id INT)
 BEGIN
   DECLARE _length INT;
 
@@ -906,13 +901,13 @@ BEGIN
     SET _offset = 0;
   END IF;
 
-  SET SQL_SELECT_LIMIT = _limit;
-
   SELECT t.name, p.name owner, p.points owner_points, t.type, t.title,
     IF(t.published IS null, null, FormatTS(t.published)) published,
     FormatTS(t.created) created, FormatTS(t.modified) modified,
     t.comments, t.stars, t.children, t.views, t.downloads,
-    GetFileURL(p.name, t.name, f.name) image
+    GetFileURL(p.name, t.name, f.name) image,
+    CONCAT_WS(':', t.published IS NOT NULL, t.stars,
+      UNIX_TIMESTAMP(t.created), t.id) sort_key
 
     FROM things t
       LEFT JOIN files f ON f.id = GetFirstImageIDByID(t.id)
@@ -926,11 +921,22 @@ BEGIN
           GROUP BY thing_id
           HAVING COUNT(thing_id) = _length
 
-      )
+      ) AND
+
+      -- Seek past the cursor, if any
+      (_after_id IS null OR
+       _after_published < (t.published IS NOT NULL) OR
+       (_after_published = (t.published IS NOT NULL) AND
+        (t.stars < _after_stars OR
+         (t.stars = _after_stars AND
+          (t.created < FROM_UNIXTIME(_after_created) OR
+           (t.created = FROM_UNIXTIME(_after_created) AND
+            t.id < _after_id))))))
 
-    ORDER BY t.published IS NOT NULL, t.stars DESC, t.created DESC;
+    ORDER BY t.published IS NOT NULL, t.stars DESC, t.created DESC,
+      t.id DESC
 
-  SET SQL_SELECT_LIMIT = DEFAULT;
+    LIMIT _limit OFFSET _offset;
 END;
 
 
@@ -1225,7 +1231,8 @@ BEGIN
 
   SET _id = (
     SELECT id FROM files
-      WHERE thing_id = _thing_id AND visibility != 'download'
+      WHERE thing_id = _thing_id AND visibility != 'download' AND
+        visibility != 'private'
       ORDER BY position, created LIMIT 1);
 
   RETURN _id;
@@ -1272,6 +1279,15 @@ CREATE PROCEDURE UpdateFile(IN _owner VARCHAR(64), IN _thing VARCHAR(64),
 BEGIN
   SET _thing = GetThingID(_owner, _thing);
 
+  -- The S3 ACL is set at upload and cannot follow a change to or from private
+  IF _visibility IS NOT null AND EXISTS (
+    SELECT * FROM files
+      WHERE thing_id = _thing AND name = _name AND
+        (visibility = 'private') != (_visibility = 'private')) THEN
+    SIGNAL SQLSTATE 'HY000' -- ER_SIGNAL_EXCEPTION
+      SET MESSAGE_TEXT = 'Cannot change the visibility of a private file';
+  END IF;
+
   UPDATE files
     SET
       name       = IFNULL(_rename, name),
@@ -1293,25 +1309,25 @@ END;
 
 
 CREATE PROCEDURE DownloadFile(IN _owner VARCHAR(64), IN _thing VARCHAR(64),
-  IN _name VARCHAR(256), IN _count BOOLEAN)
+  IN _name VARCHAR(256), IN _private BOOL)
 BEGIN
   DECLARE _file_id INT;
   DECLARE _path VARCHAR(256);
   DECLARE _type VARCHAR(64);
+  DECLARE _visibility VARCHAR(8);
+  DECLARE _space INT;
 
-  SELECT id, path, type INTO _file_id, _path, _type FROM files
+  SELECT id, path, type, visibility, space
+    INTO _file_id, _path, _type, _visibility, _space FROM files
     WHERE thing_id = GetThingID(_owner, _thing) AND name = _name;
 
-  IF _count THEN
-    UPDATE files SET downloads = downloads + 1
-      WHERE id = _file_id;
-  END IF;
-
-  IF _path IS null THEN
+  -- Downloads are counted by the server in batches
+  IF _path IS null OR (_visibility = 'private' AND NOT _private) THEN
     SIGNAL SQLSTATE '02000' -- ER_SIGNAL_NOT_FOUND
       SET MESSAGE_TEXT = 'File not found';
   ELSE
-    SELECT _path path, _type type;
+    SELECT _path path, _type type, _file_id id, _visibility visibility,
+      _space size;
   END IF;
 END;
 
@@ -1450,8 +1466,6 @@ BEGIN
     SET _offset = 0;
   END IF;
 
-  SET SQL_SELECT_LIMIT = _limit;
-
   -- Select
   SELECT p.name, p.points, p.followers, p.badges,
       FormatTS(p.joined) joined, MATCH(p.name, p.fullname, p.location, p.bio)
@@ -1465,9 +1479,9 @@ BEGIN
     HAVING
       (_query IS null OR 0 < score)
 
-    ORDER BY score DESC, p.points DESC, p.joined ASC;
+    ORDER BY score DESC, p.points DESC, p.joined ASC
 
-  SET SQL_SELECT_LIMIT = DEFAULT;
+    LIMIT _limit OFFSET _offset;
 END;
 
 
@@ -1489,8 +1503,6 @@ BEGIN
     SET _offset = 0;
   END IF;
 
-  SET SQL_SELECT_LIMIT = _limit;
-
   -- Select
   SELECT t.name, p.name owner, p.points owner_points, t.type, t.title,
     IF(t.published IS null, null, FormatTS(t.published)) published,
@@ -1511,9 +1523,111 @@ BEGIN
     HAVING
       (_query IS null OR 0 < score)
 
-    ORDER BY score DESC, t.stars DESC, t.created DESC;
+    ORDER BY score DESC, t.stars DESC, t.created DESC
+
+    LIMIT _limit OFFSET _offset;
+END;
+
+
+CREATE PROCEDURE GetSearchVersion()
+BEGIN
+  SELECT IFNULL(MIN(id), 0) min, IFNULL(MAX(id), 0) max FROM search_changes;
+END;
+
+
+-- All searchable things if _since is null, otherwise those changed after it
+-- or in the last _window seconds.  Change IDs are assigned at insert, so a
+-- change may commit after a higher ID was already read.
+CREATE PROCEDURE GetSearchThings(IN _since BIGINT, IN _window INT)
+BEGIN
+  IF _since IS null THEN
+    SELECT id, true searchable, IFNULL(license, '') license, stars,
+      UNIX_TIMESTAMP(created) created,
+      CONCAT_WS(' ', name, title, tags, instructions) text
+      FROM things
+      WHERE published IS NOT NULL;
+
+  ELSE
+    SELECT c.object_id id, t.published IS NOT NULL searchable,
+      IFNULL(t.license, '') license, t.stars, UNIX_TIMESTAMP(t.created) created,
+      CONCAT_WS(' ', t.name, t.title, t.tags, t.instructions) text
+      FROM (
+        SELECT DISTINCT object_id FROM search_changes
+          WHERE (_since < id OR NOW() - INTERVAL _window SECOND < ts) AND
+            object_type = 'thing'
+      ) c
+      LEFT JOIN things t ON t.id = c.object_id;
+  END IF;
+END;
+
+
+-- All searchable profiles if _since is null, otherwise those changed after it
+-- or in the last _window seconds
+CREATE PROCEDURE GetSearchProfiles(IN _since BIGINT, IN _window INT)
+BEGIN
+  IF _since IS null THEN
+    SELECT id, true searchable, points, UNIX_TIMESTAMP(joined) joined,
+      CONCAT_WS(' ', name, fullname, location, bio) text
+      FROM profiles
+      WHERE NOT disabled;
+
+  ELSE
+    SELECT c.object_id id, IFNULL(NOT p.disabled, false) searchable,
+      p.points, UNIX_TIMESTAMP(p.joined) joined,
+      CONCAT_WS(' ', p.name, p.fullname, p.location, p.bio) text
+      FROM (
+        SELECT DISTINCT object_id FROM search_changes
+          WHERE (_since < id OR NOW() - INTERVAL _window SECOND < ts) AND
+            object_type = 'profile'
+      ) c
+      LEFT JOIN profiles p ON p.id = c.object_id;
+  END IF;
+END;
+
+
+-- Returns things in the order of the comma separated ID list
+CREATE PROCEDURE GetThingsByIDList(IN _ids TEXT)
+BEGIN
+  IF _ids NOT REGEXP '^[0-9]+(,[0-9]+)*$' THEN
+    SIGNAL SQLSTATE 'HY000' -- ER_SIGNAL_EXCEPTION
+      SET MESSAGE_TEXT = 'Invalid ID list';
+  END IF;
+
+  SET @sql = CONCAT(
+    'SELECT t.name, p.name owner, p.points owner_points, t.type, t.title, ',
+    'IF(t.published IS null, null, FormatTS(t.published)) published, ',
+    'FormatTS(t.created) created, FormatTS(t.modified) modified, ',
+    't.comments, t.stars, t.children, t.views, t.downloads, ',
+    'GetFileURL(p.name, t.name, f.name) image ',
+    'FROM things t ',
+    'LEFT JOIN files f ON f.id = GetFirstImageIDByID(t.id) ',
+    'INNER JOIN profiles p ON t.owner_id = p.id ',
+    'WHERE t.id IN (', _ids, ') AND t.published IS NOT NULL ',
+    'ORDER BY FIELD(t.id, ', _ids, ')');
 
-  SET SQL_SELECT_LIMIT = DEFAULT;
+  PREPARE stmt FROM @sql;
+  EXECUTE stmt;
+  DEALLOCATE PREPARE stmt;
+END;
+
+
+-- Returns profiles in the order of the comma separated ID list
+CREATE PROCEDURE GetProfilesByIDList(IN _ids TEXT)
+BEGIN
+  IF _ids NOT REGEXP '^[0-9]+(,[0-9]+)*$' THEN
+    SIGNAL SQLSTATE 'HY000' -- ER_SIGNAL_EXCEPTION
+      SET MESSAGE_TEXT = 'Invalid ID list';
+  END IF;
+
+  SET @sql = CONCAT(
+    'SELECT name, points, followers, badges, FormatTS(joined) joined ',
+    'FROM profiles ',
+    'WHERE id IN (', _ids, ') AND NOT disabled ',
+    'ORDER BY FIELD(id, ', _ids, ')');
+
+  PREPARE stmt FROM @sql;
+  EXECUTE stmt;
+  DEALLOCATE PREPARE stmt;
 END;
 
 
@@ -1531,17 +1645,133 @@ BEGIN
 END;
 
 
+CREATE FUNCTION GetEventPath(_object_type VARCHAR(16), _object_id INT)
+RETURNS VARCHAR(256)
+NOT DETERMINISTIC
+READS SQL DATA
+BEGIN
+  DECLARE _path VARCHAR(256);
+
+  CASE _object_type
+    WHEN 'profile' THEN
+      SELECT name INTO _path FROM profiles WHERE id = _object_id;
+
+    WHEN 'thing' THEN
+      SELECT CONCAT(p.name, '/', t.name) INTO _path
+        FROM things t INNER JOIN profiles p ON p.id = t.owner_id
+        WHERE t.id = _object_id;
+
+    WHEN 'comment' THEN
+      SELECT CONCAT(p.name, '/', t.name, '#comment-', c.id) INTO _path
+        FROM comments c
+        INNER JOIN things t ON t.id = c.thing_id
+        INNER JOIN profiles p ON p.id = t.owner_id
+        WHERE c.id = _object_id;
+
+    WHEN 'badge' THEN
+      SELECT CONCAT('/badges', name) INTO _path
+        FROM badges WHERE id = _object_id;
+
+    ELSE BEGIN END;
+  END CASE;
+
+  RETURN _path;
+END;
+
+
 CREATE PROCEDURE Event(IN _subject_id INT, IN _action VARCHAR(16),
   IN _object_id INT)
 BEGIN
-  INSERT INTO events (subject_id, action, object_type, object_id)
-  VALUES (_subject_id, _action, GetObjectType(_action), _object_id);
+  DECLARE _object_type VARCHAR(16);
+  DECLARE _path VARCHAR(256);
+
+  SET _object_type = GetObjectType(_action);
+  SET _path = GetEventPath(_object_type, _object_id);
+
+  INSERT INTO events (subject_id, action, object_type, object_id, subject,
+    path)
+  VALUES (_subject_id, _action, _object_type, _object_id,
+    (SELECT name FROM profiles WHERE id = _subject_id), _path);
+
+  -- Fan out to the subject's and its followers' feeds
+  IF _path IS NOT null THEN
+    INSERT INTO feeds (profile_id, event_id, subject_id)
+      SELECT f.profile_id, LAST_INSERT_ID(), _subject_id
+        FROM (
+          SELECT _subject_id profile_id
+          UNION
+          SELECT follower_id FROM followers WHERE followed_id = _subject_id
+        ) f;
+  END IF;
+END;
+
+
+-- Keep the stored event paths in sync with renames
+CREATE PROCEDURE UpdateThingEventPaths(IN _thing_id INT)
+BEGIN
+  UPDATE events SET path = GetEventPath(object_type, object_id)
+    WHERE
+      (object_type = 'thing' AND object_id = _thing_id) OR
+      (object_type = 'comment' AND object_id IN
+        (SELECT id FROM comments WHERE thing_id = _thing_id));
+END;
+
+
+CREATE PROCEDURE UpdateProfileEventPaths(IN _profile_id INT)
+BEGIN
+  UPDATE events SET subject = (SELECT name FROM profiles WHERE id = _profile_id)
+    WHERE subject_id = _profile_id;
+
+  UPDATE events SET path = GetEventPath(object_type, object_id)
+    WHERE
+      (object_type = 'profile' AND object_id = _profile_id) OR
+      (object_type = 'thing' AND object_id IN
+        (SELECT id FROM things WHERE owner_id = _profile_id)) OR
+      (object_type = 'comment' AND object_id IN
+        (SELECT c.id FROM comments c
+          INNER JOIN things t ON t.id = c.thing_id
+          WHERE t.owner_id = _profile_id));
+END;
+
+
+-- Copies the followed profile's recent events into the follower's feed
+CREATE PROCEDURE BackfillFeed(IN _follower_id INT, IN _followed_id INT)
+BEGIN
+  INSERT IGNORE INTO feeds (profile_id, event_id, subject_id)
+    SELECT _follower_id, id, subject_id
+      FROM events
+      WHERE subject_id = _followed_id AND path IS NOT null
+      ORDER BY id DESC
+      LIMIT 100;
+END;
+
+
+-- Keeps only the most recent 1000 events in each feed
+CREATE PROCEDURE TrimFeeds()
+BEGIN
+  DROP TEMPORARY TABLE IF EXISTS feed_cutoffs;
+
+  CREATE TEMPORARY TABLE feed_cutoffs AS
+    SELECT p.profile_id,
+      (SELECT event_id FROM feeds f
+        WHERE f.profile_id = p.profile_id
+        ORDER BY event_id DESC LIMIT 1 OFFSET 999) event_id
+      FROM (
+        SELECT profile_id FROM feeds
+          GROUP BY profile_id HAVING 1000 < COUNT(*)
+      ) p;
+
+  DELETE f FROM feeds f
+    INNER JOIN feed_cutoffs c ON f.profile_id = c.profile_id
+    WHERE f.event_id < c.event_id;
+
+  DROP TEMPORARY TABLE feed_cutoffs;
 END;
 
 
 CREATE PROCEDURE GetEventsByID(IN _subject_id INT, IN _action VARCHAR(16),
   IN _object_type VARCHAR(16), IN _object_id INT, IN _following BOOLEAN,
-  IN _since TIMESTAMP, IN _limit INT)
+  IN _since TIMESTAMP, IN _limit INT, IN _before INT)
 BEGIN
   IF _limit IS null THEN
     SET _limit = 100;
@@ -1551,49 +1781,74 @@ BEGIN
     SET _following = false;
   END IF;
 
-  SELECT FormatTS(e.ts) ts, s.name subject, e.action, e.object_type,
-    COALESCE(
-      p.name,
-      CONCAT(tp.name, '/', t.name),
-      CONCAT(cp.name, '/', ct.name, '#comment-', c.id),
-      CONCAT('/badges', b.name)
-    ) path
+  IF _following AND _subject_id IS NOT null THEN
+    -- Read the materialized feed, keep columns in sync with below
+    SELECT FormatTS(e.ts) ts, e.subject, e.action, e.object_type, e.path,
+      e.id sort_key
 
-    FROM events e
+      FROM feeds f
 
-    LEFT JOIN profiles s  ON s.id = e.subject_id
+      INNER JOIN events e ON e.id = f.event_id
 
-    LEFT JOIN profiles p  ON e.object_type = 'profile' AND p.id = e.object_id
+      WHERE
+        f.profile_id = _subject_id AND
+        (_action      IS null OR FIND_IN_SET(e.action, _action)) AND
+        (_object_type IS null OR e.object_type = _object_type) AND
+        (_object_id   IS null OR e.object_id   = _object_id) AND
+        (_since       IS null OR _since       <= e.ts) AND
+        (_before      IS null OR f.event_id    < _before)
 
-    LEFT JOIN things t    ON e.object_type = 'thing'   AND t.id = e.object_id
-    LEFT JOIN profiles tp ON e.object_type = 'thing'   AND tp.id = t.owner_id
+      ORDER BY f.event_id DESC
 
-    LEFT JOIN comments c  ON e.object_type = 'comment' AND c.id = e.object_id
-    LEFT JOIN things ct   ON e.object_type = 'comment' AND ct.id = c.thing_id
-    LEFT JOIN profiles cp ON e.object_type = 'comment' AND cp.id = ct.owner_id
+      LIMIT _limit;
 
-    LEFT JOIN badges b    ON e.object_type = 'badge'   AND b.id = e.object_id
+  ELSE
+    SELECT FormatTS(ts) ts, subject, action, object_type, path, id sort_key
 
-    WHERE
-      (_subject_id IS null OR e.subject_id = _subject_id OR
-       (_following AND e.subject_id IN (SELECT followed_id FROM followers
-          WHERE follower_id = _subject_id))) AND
-      (_action      IS null OR FIND_IN_SET(e.action, _action)) AND
-      (_object_type IS null OR e.object_type = _object_type) AND
-      (_object_id   IS null OR e.object_id   = _object_id) AND
-      (_since       IS null OR _since       <= e.ts)
+      FROM events
 
-    HAVING path IS NOT null
+      WHERE
+        (_subject_id  IS null OR subject_id  = _subject_id) AND
+        (_action      IS null OR FIND_IN_SET(action, _action)) AND
+        (_object_type IS null OR object_type = _object_type) AND
+        (_object_id   IS null OR object_id   = _object_id) AND
+        (_since       IS null OR _since     <= ts) AND
+        (_before      IS null OR id          < _before) AND
+        path IS NOT null
 
-    ORDER BY e.id DESC
+      ORDER BY id DESC
 
-    LIMIT _limit;
+      LIMIT _limit;
+  END IF;
+END;
+
+
+-- Oldest first, read by the server's event bus.  Without _after the most
+-- recent events are returned.
+CREATE PROCEDURE GetEventsAfter(IN _after INT, IN _limit INT)
+BEGIN
+  IF _after IS null THEN
+    SELECT * FROM (
+      SELECT id, FormatTS(ts) ts, subject, action, object_type, path
+        FROM events
+        ORDER BY id DESC
+        LIMIT _limit
+    ) e ORDER BY id;
+
+  ELSE
+    SELECT id, FormatTS(ts) ts, subject, action, object_type, path
+      FROM events
+      WHERE _after < id
+      ORDER BY id
+      LIMIT _limit;
+  END IF;
 END;
 
 
 CREATE PROCEDURE GetEvents(IN _subject VARCHAR(64), IN _action VARCHAR(16),
   IN _object_type VARCHAR(16), IN _object VARCHAR(64), IN _owner VARCHAR(64),
-  IN _following BOOLEAN, IN _since TIMESTAMP, IN _limit INT)
+  IN _following BOOLEAN, IN _since TIMESTAMP, IN _limit INT,
+  IN _before INT)
 BEGIN
   DECLARE _subject_id INT;
   DECLARE _object_id INT;
@@ -1650,20 +1905,255 @@ BEGIN
   END IF;
 
   CALL GetEventsByID(_subject_id, _action, _object_type, _object_id, _following,
-    _since, _limit);
+    _since, _limit, _before);
 END;
 
 
 CREATE PROCEDURE Maintenance()
 BEGIN
   -- Clean thing views
-  DELETE FROM thing_views WHERE ts < now() - INTERVAL 1 day;
+  DELETE FROM thing_views WHERE ts < now() - INTERVAL 1 day AND counted;
+
+  -- Clean search changes, servers further behind rebuild their index
+  DELETE FROM search_changes WHERE ts < now() - INTERVAL 1 day;
+
+  -- Trim feeds
+  CALL TrimFeeds();
+
+  -- Check counters changed since the last run
+  CALL ReconcileCounts();
 
   -- Clean old unconfirmed files
   DELETE FROM files WHERE created < now() - INTERVAL 6 hour AND NOT confirmed;
 END;
 
 
+CREATE PROCEDURE CountThingViews()
+BEGIN
+  START TRANSACTION;
+
+  -- Count and mark exactly the same views, later inserts wait for next time
+  DROP TEMPORARY TABLE IF EXISTS new_views;
+
+  CREATE TEMPORARY TABLE new_views (
+    thing_id INT NOT NULL,
+    user     VARCHAR(64) NOT NULL,
+    PRIMARY KEY (thing_id, user)
+  );
+
+  INSERT INTO new_views
+    SELECT thing_id, user FROM thing_views WHERE NOT counted FOR UPDATE;
+
+  UPDATE things t
+    INNER JOIN (
+      SELECT thing_id, COUNT(*) count
+        FROM new_views
+        GROUP BY thing_id
+    ) v ON t.id = v.thing_id
+    SET t.views = t.views + v.count;
+
+  UPDATE thing_views v
+    INNER JOIN new_views n ON n.thing_id = v.thing_id AND n.user = v.user
+    SET v.counted = true;
+
+  DROP TEMPORARY TABLE new_views;
+
+  COMMIT;
+END;
+
+
+CREATE PROCEDURE CountDelta(IN _tbl VARCHAR(16), IN _row_id INT,
+  IN _col VARCHAR(16), IN _delta INT)
+BEGIN
+  IF _delta != 0 AND _row_id IS NOT null THEN
+    INSERT INTO counter_deltas (tbl, row_id, col, delta)
+      VALUES (_tbl, _row_id, _col, _delta);
+  END IF;
+END;
+
+
+CREATE PROCEDURE ApplyCounterDeltas()
+BEGIN
+  DECLARE _to BIGINT;
+
+  -- One batch at a time, shared with ReconcileCounts()
+  IF GET_LOCK('counter_deltas', 10) THEN
+    START TRANSACTION;
+
+    SELECT MAX(id) INTO _to FROM counter_deltas WHERE NOT applied;
+
+    IF _to IS NOT null THEN
+      UPDATE things t
+        INNER JOIN (
+          SELECT row_id, SUM(IF(col = 'stars', delta, 0)) stars,
+            SUM(IF(col = 'comments', delta, 0)) comments
+            FROM counter_deltas
+            WHERE NOT applied AND id <= _to AND tbl = 'things'
+            GROUP BY row_id) d
+        ON t.id = d.row_id
+        SET t.stars = t.stars + d.stars, t.comments = t.comments + d.comments;
+
+      UPDATE profiles p
+        INNER JOIN (
+          SELECT row_id, SUM(IF(col = 'stars', delta, 0)) stars,
+            SUM(IF(col = 'comments', delta, 0)) comments,
+            SUM(IF(col = 'points', delta, 0)) points,
+            SUM(IF(col = 'followers', delta, 0)) followers,
+            SUM(IF(col = 'following', delta, 0)) following
+            FROM counter_deltas
+            WHERE NOT applied AND id <= _to AND tbl = 'profiles'
+            GROUP BY row_id) d
+        ON p.id = d.row_id
+        SET p.stars = p.stars + d.stars, p.comments = p.comments + d.comments,
+          p.points = p.points + d.points,
+          p.followers = p.followers + d.followers,
+          p.following = p.following + d.following;
+
+      UPDATE tags t
+        INNER JOIN (
+          SELECT row_id, SUM(delta) count
+            FROM counter_deltas
+            WHERE NOT applied AND id <= _to AND tbl = 'tags' AND col = 'count'
+            GROUP BY row_id) d
+        ON t.id = d.row_id
+        SET t.count = t.count + d.count;
+
+      -- Fires UpdateComments, which adjusts profile points
+      UPDATE comments c
+        INNER JOIN (
+          SELECT row_id, SUM(IF(col = 'upvotes', delta, 0)) upvotes,
+            SUM(IF(col = 'downvotes', delta, 0)) downvotes
+            FROM counter_deltas
+            WHERE NOT applied AND id <= _to AND tbl = 'comments'
+            GROUP BY row_id) d
+        ON c.id = d.row_id
+        SET c.upvotes = c.upvotes + d.upvotes,
+          c.downvotes = c.downvotes + d.downvotes;
+
+      UPDATE files f
+        INNER JOIN (
+          SELECT row_id, SUM(delta) downloads
+            FROM counter_deltas
+            WHERE NOT applied AND id <= _to AND tbl = 'files' AND
+              col = 'downloads'
+            GROUP BY row_id) d
+        ON f.id = d.row_id
+        SET f.downloads = f.downloads + d.downloads;
+
+      UPDATE counter_deltas SET applied = true WHERE NOT applied AND id <= _to;
+    END IF;
+
+    COMMIT;
+    DO RELEASE_LOCK('counter_deltas');
+  END IF;
+END;
+
+
+-- Recounts only the rows touched by applied deltas.  Rows with deltas still
+-- pending are left for the next run.  The recount is taken before the pending
+-- check.  A row the recount saw was committed with its delta, so the check
+-- sees that delta and the recount is dropped rather than counted twice.
+CREATE PROCEDURE ReconcileCounts()
+BEGIN
+  DECLARE _to BIGINT;
+
+  IF GET_LOCK('counter_deltas', 10) THEN
+    START TRANSACTION;
+
+    SELECT MAX(id) INTO _to FROM counter_deltas WHERE applied;
+
+    IF _to IS NOT null THEN
+      DROP TEMPORARY TABLE IF EXISTS counter_rows;
+      DROP TEMPORARY TABLE IF EXISTS counter_checks;
+
+      CREATE TEMPORARY TABLE counter_rows (
+        tbl    VARCHAR(16) NOT NULL,
+        row_id INT NOT NULL,
+        PRIMARY KEY (tbl, row_id)
+      );
+
+      -- Recounted values, named after the columns they replace
+      CREATE TEMPORARY TABLE counter_checks (
+        tbl       VARCHAR(16) NOT NULL,
+        row_id    INT NOT NULL,
+        stars     INT,
+        comments  INT,
+        followers INT,
+        following INT,
+        count     INT,
+        upvotes   INT,
+        downvotes INT,
+        PRIMARY KEY (tbl, row_id)
+      );
+
+      INSERT IGNORE INTO counter_rows
+        SELECT tbl, row_id FROM counter_deltas WHERE applied AND id <= _to;
+
+      INSERT INTO counter_checks (tbl, row_id, stars, comments)
+        SELECT r.tbl, r.row_id,
+          (SELECT COUNT(*) FROM stars WHERE thing_id = r.row_id),
+          (SELECT COUNT(*) FROM comments
+            WHERE thing_id = r.row_id AND NOT deleted)
+          FROM counter_rows r WHERE r.tbl = 'things';
+
+      -- Profile stars and points have no single source to recount from
+      INSERT INTO counter_checks (tbl, row_id, comments, followers, following)
+        SELECT r.tbl, r.row_id,
+          (SELECT COUNT(*) FROM comments
+            WHERE owner_id = r.row_id AND NOT deleted),
+          (SELECT COUNT(*) FROM followers WHERE followed_id = r.row_id),
+          (SELECT COUNT(*) FROM followers WHERE follower_id = r.row_id)
+          FROM counter_rows r WHERE r.tbl = 'profiles';
+
+      INSERT INTO counter_checks (tbl, row_id, count)
+        SELECT r.tbl, r.row_id,
+          (SELECT COUNT(*) FROM thing_tags WHERE tag_id = r.row_id)
+          FROM counter_rows r WHERE r.tbl = 'tags';
+
+      INSERT INTO counter_checks (tbl, row_id, upvotes, downvotes)
+        SELECT r.tbl, r.row_id,
+          (SELECT COUNT(*) FROM comment_votes
+            WHERE comment_id = r.row_id AND 0 < vote),
+          (SELECT COUNT(*) FROM comment_votes
+            WHERE comment_id = r.row_id AND vote < 0)
+          FROM counter_rows r WHERE r.tbl = 'comments';
+
+      -- A DML subquery reads the latest committed rows, not the snapshot
+      DELETE x FROM counter_checks x
+        WHERE EXISTS (
+          SELECT 1 FROM counter_deltas p
+            WHERE NOT p.applied AND p.tbl = x.tbl AND p.row_id = x.row_id);
+
+      UPDATE things t
+        INNER JOIN counter_checks x ON x.tbl = 'things' AND x.row_id = t.id
+        SET t.stars = x.stars, t.comments = x.comments;
+
+      UPDATE profiles p
+        INNER JOIN counter_checks x ON x.tbl = 'profiles' AND x.row_id = p.id
+        SET p.comments = x.comments, p.followers = x.followers,
+          p.following = x.following;
+
+      UPDATE tags t
+        INNER JOIN counter_checks x ON x.tbl = 'tags' AND x.row_id = t.id
+        SET t.count = x.count;
+
+      -- Fires UpdateComments, which adjusts profile points
+      UPDATE comments c
+        INNER JOIN counter_checks x ON x.tbl = 'comments' AND x.row_id = c.id
+        SET c.upvotes = x.upvotes, c.downvotes = x.downvotes;
+
+      DROP TEMPORARY TABLE counter_rows;
+      DROP TEMPORARY TABLE counter_checks;
+
+      DELETE FROM counter_deltas WHERE applied AND id <= _to;
+    END IF;
+
+    COMMIT;
+    DO RELEASE_LOCK('counter_deltas');
+  END IF;
+END;
+
+
 CREATE PROCEDURE FixAllCounts()
 BEGIN
   CALL FixStarCounts();
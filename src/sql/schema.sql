@@ -299,8 +299,10 @@ CREATE TABLE IF NOT EXISTS thing_views (
   thing_id INT NOT NULL,
   user     VARCHAR(64) NOT NULL,
   ts       TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  counted  BOOL NOT NULL DEFAULT false,
 
   UNIQUE (thing_id, user),
+  INDEX (counted),
   FOREIGN KEY (`thing_id`) REFERENCES things(`id`) ON DELETE CASCADE
 );
 
@@ -442,9 +444,54 @@ CREATE TABLE IF NOT EXISTS events (
   action      VARCHAR(16) NOT NULL,
   object_type VARCHAR(16) NOT NULL,
   object_id   INT NOT NULL,
+  subject     VARCHAR(64),
+  path        VARCHAR(256),
 
   PRIMARY KEY (id, subject_id),
+  INDEX (object_type, object_id),
   FOREIGN KEY (`subject_id`) REFERENCES profiles(id) ON DELETE CASCADE,
   FOREIGN KEY (`action`) REFERENCES event_actions(name),
   FOREIGN KEY (`object_type`) REFERENCES event_object_types(name)
 );
+
+
+-- Per-profile home feeds, the recent events of the profile and everyone it
+-- follows.  Filled by Event(), see TrimFeeds().
+CREATE TABLE IF NOT EXISTS feeds (
+  profile_id  INT NOT NULL,
+  event_id    INT NOT NULL,
+  subject_id  INT NOT NULL,
+
+  PRIMARY KEY (profile_id, event_id),
+  FOREIGN KEY (`profile_id`) REFERENCES profiles(id) ON DELETE CASCADE,
+  FOREIGN KEY (`event_id`) REFERENCES events(id) ON DELETE CASCADE
+);
+
+
+-- Counter changes waiting to be applied in batches by ApplyCounterDeltas().
+-- Applied rows are kept until ReconcileCounts() has checked the counters
+-- they touched.
+CREATE TABLE IF NOT EXISTS counter_deltas (
+  id      BIGINT NOT NULL AUTO_INCREMENT,
+  tbl     VARCHAR(16) NOT NULL,
+  row_id  INT NOT NULL,
+  col     VARCHAR(16) NOT NULL,
+  delta   INT NOT NULL,
+  applied BOOL NOT NULL DEFAULT false,
+
+  PRIMARY KEY (id),
+  INDEX (applied, id),
+  INDEX (tbl, row_id)
+);
+
+
+-- Changes to searchable things and profiles, read by the server's search index
+CREATE TABLE IF NOT EXISTS search_changes (
+  id          BIGINT NOT NULL AUTO_INCREMENT,
+  ts          TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  object_type VARCHAR(16) NOT NULL,
+  object_id   INT NOT NULL,
+
+  PRIMARY KEY (id),
+  INDEX (ts)
+);
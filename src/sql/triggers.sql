@@ -1,4 +1,13 @@
 -- Things
+DROP TRIGGER IF EXISTS InsertThings;
+CREATE TRIGGER InsertThings AFTER INSERT ON things
+FOR EACH ROW
+BEGIN
+  -- Search
+  INSERT INTO search_changes (object_type, object_id) VALUES ('thing', NEW.id);
+END;
+
+
 DROP TRIGGER IF EXISTS UpdateThings;
 CREATE TRIGGER UpdateThings AFTER UPDATE ON things
 FOR EACH ROW
@@ -15,12 +24,35 @@ BEGIN
     END IF;
   END IF;
 
+  IF OLD.name != NEW.name THEN
+    CALL UpdateThingEventPaths(NEW.id);
+  END IF;
+
   -- Space
   IF NEW.space != OLD.space THEN
     UPDATE profiles
       SET space = space + NEW.space - OLD.space
       WHERE id = OLD.owner_id;
   END IF;
+
+  -- Search
+  IF NOT (NEW.name <=> OLD.name AND NEW.title <=> OLD.title AND
+    NEW.tags <=> OLD.tags AND NEW.instructions <=> OLD.instructions AND
+    NEW.published <=> OLD.published AND NEW.license <=> OLD.license AND
+    NEW.stars <=> OLD.stars) THEN
+    INSERT INTO search_changes (object_type, object_id)
+      VALUES ('thing', NEW.id);
+  END IF;
+END;
+
+
+DROP TRIGGER IF EXISTS BeforeDeleteThings;
+CREATE TRIGGER BeforeDeleteThings BEFORE DELETE ON things
+FOR EACH ROW
+BEGIN
+  -- Comment events, the comments are gone by the time DeleteThings runs
+  DELETE FROM events WHERE object_type = 'comment' AND object_id IN
+    (SELECT id FROM comments WHERE thing_id = OLD.id);
 END;
 
 
@@ -30,17 +62,49 @@ FOR EACH ROW
 BEGIN
   -- Events
   DELETE FROM events WHERE object_type = 'thing' AND object_id = OLD.id;
+
+  -- Search
+  INSERT INTO search_changes (object_type, object_id) VALUES ('thing', OLD.id);
 END;
 
 
--- Thing Views
-DROP TRIGGER IF EXISTS InsertThingViews;
-CREATE TRIGGER InsertThingViews AFTER INSERT ON thing_views
+-- Profiles
+DROP TRIGGER IF EXISTS InsertProfiles;
+CREATE TRIGGER InsertProfiles AFTER INSERT ON profiles
 FOR EACH ROW
 BEGIN
-  UPDATE things
-    SET views = views + 1
-    WHERE id = NEW.thing_id;
+  -- Search
+  INSERT INTO search_changes (object_type, object_id)
+    VALUES ('profile', NEW.id);
+END;
+
+
+DROP TRIGGER IF EXISTS UpdateProfiles;
+CREATE TRIGGER UpdateProfiles AFTER UPDATE ON profiles
+FOR EACH ROW
+BEGIN
+  -- Events
+  IF OLD.name != NEW.name THEN
+    CALL UpdateProfileEventPaths(NEW.id);
+  END IF;
+
+  -- Search
+  IF NOT (NEW.name <=> OLD.name AND NEW.fullname <=> OLD.fullname AND
+    NEW.location <=> OLD.location AND NEW.bio <=> OLD.bio AND
+    NEW.disabled <=> OLD.disabled AND NEW.points <=> OLD.points) THEN
+    INSERT INTO search_changes (object_type, object_id)
+      VALUES ('profile', NEW.id);
+  END IF;
+END;
+
+
+DROP TRIGGER IF EXISTS DeleteProfiles;
+CREATE TRIGGER DeleteProfiles AFTER DELETE ON profiles
+FOR EACH ROW
+BEGIN
+  -- Search
+  INSERT INTO search_changes (object_type, object_id)
+    VALUES ('profile', OLD.id);
 END;
 
 
@@ -52,26 +116,31 @@ BEGIN
   -- Event
   CALL Event(NEW.follower_id, 'follow', NEW.followed_id);
 
+  -- Feed
+  CALL BackfillFeed(NEW.follower_id, NEW.followed_id);
+
   -- Inc profile followers & points
-  UPDATE profiles SET followers = followers + 1, points = points + 25
-    WHERE id = NEW.followed_id;
+  CALL CountDelta('profiles', NEW.followed_id, 'followers', 1);
+  CALL CountDelta('profiles', NEW.followed_id, 'points', 25);
 
   -- Inc profile following
-  UPDATE profiles SET following = following + 1
-    WHERE id = NEW.follower_id;
+  CALL CountDelta('profiles', NEW.follower_id, 'following', 1);
 END;
 
 DROP TRIGGER IF EXISTS DeleteFollowers;
 CREATE TRIGGER DeleteFollowers AFTER DELETE ON followers
 FOR EACH ROW
 BEGIN
+  -- Feed
+  DELETE FROM feeds
+    WHERE profile_id = OLD.follower_id AND subject_id = OLD.followed_id;
+
   -- Dec profile followers
-  UPDATE profiles SET followers = followers - 1, points = points - 25
-    WHERE id = OLD.followed_id;
+  CALL CountDelta('profiles', OLD.followed_id, 'followers', -1);
+  CALL CountDelta('profiles', OLD.followed_id, 'points', -25);
 
   -- Dec profile following
-  UPDATE profiles SET following = following - 1
-    WHERE id = OLD.follower_id;
+  CALL CountDelta('profiles', OLD.follower_id, 'following', -1);
 END;
 
 
@@ -91,8 +160,7 @@ BEGIN
       (tags IS NULL OR NOT FIND_IN_SET(_tag, tags));
 
   -- Inc tag count
-  UPDATE tags SET count = count + 1
-    WHERE id = NEW.tag_id;
+  CALL CountDelta('tags', NEW.tag_id, 'count', 1);
 END;
 
 DROP TRIGGER IF EXISTS DeleteThingTags;
@@ -109,8 +177,7 @@ BEGIN
     WHERE id = OLD.thing_id;
 
   -- Dec tag count
-  UPDATE tags SET count = count - 1
-    WHERE id = OLD.tag_id;
+  CALL CountDelta('tags', OLD.tag_id, 'count', -1);
 END;
 
 
@@ -119,25 +186,31 @@ DROP TRIGGER IF EXISTS InsertStars;
 CREATE TRIGGER InsertStars AFTER INSERT ON stars
 FOR EACH ROW
 BEGIN
+  DECLARE _owner_id INT;
+
   -- Event
   CALL Event(NEW.profile_id, 'star', NEW.thing_id);
 
   -- Inc profile stars & points
-  UPDATE profiles SET stars = stars + 1, points = points + 10
-    WHERE id = (SELECT owner_id FROM things WHERE id = NEW.thing_id);
+  SELECT owner_id INTO _owner_id FROM things WHERE id = NEW.thing_id;
+  CALL CountDelta('profiles', _owner_id, 'stars', 1);
+  CALL CountDelta('profiles', _owner_id, 'points', 10);
 
   -- Inc thing stars
-  UPDATE things SET stars = stars + 1 WHERE id = NEW.thing_id;
+  CALL CountDelta('things', NEW.thing_id, 'stars', 1);
 END;
 
 DROP TRIGGER IF EXISTS DeleteStars;
 CREATE TRIGGER DeleteStars AFTER DELETE ON stars
 FOR EACH ROW
 BEGIN
+  DECLARE _owner_id INT;
+
   -- Dec profile stars
-  UPDATE profiles SET stars = stars - 1, points = points - 10
-    WHERE id = (SELECT owner_id FROM things WHERE id = OLD.thing_id);
-  UPDATE things SET stars = stars - 1 WHERE id = OLD.thing_id;
+  SELECT owner_id INTO _owner_id FROM things WHERE id = OLD.thing_id;
+  CALL CountDelta('profiles', _owner_id, 'stars', -1);
+  CALL CountDelta('profiles', _owner_id, 'points', -10);
+  CALL CountDelta('things', OLD.thing_id, 'stars', -1);
 END;
 
 
@@ -150,18 +223,21 @@ BEGIN
   CALL Event(NEW.owner_id, 'comment', NEW.id);
 
   -- Inc profile comments
-  UPDATE profiles SET comments = comments + 1 WHERE id = NEW.owner_id;
+  CALL CountDelta('profiles', NEW.owner_id, 'comments', 1);
 
   -- Inc thing comments
-  UPDATE things SET comments = comments + 1 WHERE id = NEW.thing_id;
+  CALL CountDelta('things', NEW.thing_id, 'comments', 1);
 END;
 
 DROP TRIGGER IF EXISTS UpdateComments;
 CREATE TRIGGER UpdateComments AFTER UPDATE ON comments
 FOR EACH ROW
 BEGIN
-  -- Profile points
-  IF NEW.upvotes != OLD.upvotes OR NEW.downvotes != OLD.downvotes THEN
+  -- Profile points follow the vote counts of comments that are not deleted.
+  -- The counts lag behind pending deltas, so points only change when they
+  -- are applied.
+  IF NOT OLD.deleted AND NOT NEW.deleted AND
+    (NEW.upvotes != OLD.upvotes OR NEW.downvotes != OLD.downvotes) THEN
     UPDATE profiles
       SET points = points - OLD.upvotes + NEW.upvotes +
         OLD.downvotes - NEW.downvotes
@@ -178,26 +254,26 @@ BEGIN
     END IF;
 
     -- Dec profile comments
-    UPDATE profiles SET comments = comments - 1 WHERE id = OLD.owner_id;
+    CALL CountDelta('profiles', OLD.owner_id, 'comments', -1);
 
     -- Dec thing comments
-    UPDATE things SET comments = comments - 1 WHERE id = OLD.thing_id;
+    CALL CountDelta('things', OLD.thing_id, 'comments', -1);
   END IF;
 
   -- Undeleted comments
   IF OLD.deleted AND NOT NEW.deleted THEN
     -- Profile points
-    IF OLD.upvotes OR OLD.downvotes THEN
+    IF NEW.upvotes OR NEW.downvotes THEN
       UPDATE profiles
-        SET points = points + OLD.upvotes - OLD.downvotes
-        WHERE id = OLD.owner_id;
+        SET points = points + NEW.upvotes - NEW.downvotes
+        WHERE id = NEW.owner_id;
     END IF;
 
     -- Inc profile comments
-    UPDATE profiles SET comments = comments + 1 WHERE id = OLD.owner_id;
+    CALL CountDelta('profiles', OLD.owner_id, 'comments', 1);
 
     -- Inc thing comments
-    UPDATE things SET comments = comments + 1 WHERE id = OLD.thing_id;
+    CALL CountDelta('things', OLD.thing_id, 'comments', 1);
   END IF;
 END;
 
@@ -205,6 +281,9 @@ DROP TRIGGER IF EXISTS DeleteComments;
 CREATE TRIGGER DeleteComments AFTER DELETE ON comments
 FOR EACH ROW
 BEGIN
+  -- Events
+  DELETE FROM events WHERE object_type = 'comment' AND object_id = OLD.id;
+
   IF NOT OLD.deleted THEN
     -- Profile points
     IF OLD.upvotes OR OLD.downvotes THEN
@@ -214,10 +293,10 @@ BEGIN
     END IF;
 
     -- Dec profile comments
-    UPDATE profiles SET comments = comments - 1 WHERE id = OLD.owner_id;
+    CALL CountDelta('profiles', OLD.owner_id, 'comments', -1);
 
     -- Dec thing comments
-    UPDATE things SET comments = comments - 1 WHERE id = OLD.thing_id;
+    CALL CountDelta('things', OLD.thing_id, 'comments', -1);
   END IF;
 END;
 
@@ -229,13 +308,13 @@ FOR EACH ROW
 BEGIN
   -- Comment votes
   IF 0 < NEW.vote THEN
-    UPDATE comments SET upvotes = upvotes + 1 WHERE id = NEW.comment_id;
+    CALL CountDelta('comments', NEW.comment_id, 'upvotes', 1);
 
   ELSE
-    UPDATE comments SET downvotes = downvotes + 1 WHERE id = NEW.comment_id;
+    CALL CountDelta('comments', NEW.comment_id, 'downvotes', 1);
 
     -- Profile points
-    UPDATE profiles SET points = points - 1 WHERE id = NEW.profile_id;
+    CALL CountDelta('profiles', NEW.profile_id, 'points', -1);
   END IF;
 END;
 
@@ -244,18 +323,17 @@ CREATE TRIGGER UpdateCommentVotes AFTER UPDATE ON comment_votes
 FOR EACH ROW
 BEGIN
   -- Comment votes
-  UPDATE comments
-    SET
-      upvotes = upvotes + IF(NEW.vote = 1, 1, IF(OLD.vote = 1, -1, 0)),
-      downvotes = downvotes + IF(NEW.vote = -1, 1, IF(OLD.vote = -1, -1, 0))
-    WHERE id = NEW.comment_id;
+  CALL CountDelta('comments', NEW.comment_id, 'upvotes',
+    IF(NEW.vote = 1, 1, IF(OLD.vote = 1, -1, 0)));
+  CALL CountDelta('comments', NEW.comment_id, 'downvotes',
+    IF(NEW.vote = -1, 1, IF(OLD.vote = -1, -1, 0)));
 
   -- Profile points
   IF NEW.vote = -1 THEN
-    UPDATE profiles SET points = points - 1 WHERE id = NEW.profile_id;
+    CALL CountDelta('profiles', NEW.profile_id, 'points', -1);
   END IF;
   IF OLD.vote = -1 THEN
-    UPDATE profiles SET points = points + 1 WHERE id = NEW.profile_id;
+    CALL CountDelta('profiles', NEW.profile_id, 'points', 1);
   END IF;
 END;
 
@@ -0,0 +1,8 @@
+-- Thing views are counted in batches by CountThingViews()
+DROP TRIGGER IF EXISTS InsertThingViews;
+
+ALTER TABLE thing_views
+  ADD counted BOOL NOT NULL DEFAULT true,
+  ADD INDEX (counted);
+
+ALTER TABLE thing_views ALTER counted SET DEFAULT false;
@@ -0,0 +1,10 @@
+-- Changes to searchable things and profiles, read by the server's search index
+CREATE TABLE IF NOT EXISTS search_changes (
+  id          BIGINT NOT NULL AUTO_INCREMENT,
+  ts          TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  object_type VARCHAR(16) NOT NULL,
+  object_id   INT NOT NULL,
+
+  PRIMARY KEY (id),
+  INDEX (ts)
+);
@@ -0,0 +1,52 @@
+-- Per-profile home feeds, the recent events of the profile and everyone it
+-- follows with their paths resolved.  Filled by Event(), see TrimFeeds().
+CREATE TABLE IF NOT EXISTS feeds (
+  profile_id  INT NOT NULL,
+  event_id    INT NOT NULL,
+  ts          TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  subject_id  INT NOT NULL,
+  action      VARCHAR(16) NOT NULL,
+  object_type VARCHAR(16) NOT NULL,
+  object_id   INT NOT NULL,
+  path        VARCHAR(256) NOT NULL,
+
+  PRIMARY KEY (profile_id, event_id),
+  FOREIGN KEY (`profile_id`) REFERENCES profiles(id) ON DELETE CASCADE,
+  FOREIGN KEY (`event_id`) REFERENCES events(id) ON DELETE CASCADE
+);
+
+
+-- Fill feeds with the last month of events
+INSERT INTO feeds (profile_id, event_id, ts, subject_id, action, object_type,
+  object_id, path)
+  SELECT f.profile_id, e.id, e.ts, e.subject_id, e.action, e.object_type,
+    e.object_id,
+    COALESCE(
+      p.name,
+      CONCAT(tp.name, '/', t.name),
+      CONCAT(cp.name, '/', ct.name, '#comment-', c.id),
+      CONCAT('/badges', b.name)
+    ) path
+
+    FROM events e
+
+    INNER JOIN (
+      SELECT id profile_id, id subject_id FROM profiles
+      UNION
+      SELECT follower_id, followed_id FROM followers
+    ) f ON f.subject_id = e.subject_id
+
+    LEFT JOIN profiles p  ON e.object_type = 'profile' AND p.id = e.object_id
+
+    LEFT JOIN things t    ON e.object_type = 'thing'   AND t.id = e.object_id
+    LEFT JOIN profiles tp ON e.object_type = 'thing'   AND tp.id = t.owner_id
+
+    LEFT JOIN comments c  ON e.object_type = 'comment' AND c.id = e.object_id
+    LEFT JOIN things ct   ON e.object_type = 'comment' AND ct.id = c.thing_id
+    LEFT JOIN profiles cp ON e.object_type = 'comment' AND cp.id = ct.owner_id
+
+    LEFT JOIN badges b    ON e.object_type = 'badge'   AND b.id = e.object_id
+
+    WHERE now() - INTERVAL 1 month <= e.ts
+
+    HAVING path IS NOT null;
@@ -0,0 +1,36 @@
+-- Events store their subject name and resolved path
+ALTER TABLE events
+  ADD subject VARCHAR(64),
+  ADD path    VARCHAR(256),
+  ADD INDEX (object_type, object_id);
+
+UPDATE events e
+  LEFT JOIN profiles s  ON s.id = e.subject_id
+
+  LEFT JOIN profiles p  ON e.object_type = 'profile' AND p.id = e.object_id
+
+  LEFT JOIN things t    ON e.object_type = 'thing'   AND t.id = e.object_id
+  LEFT JOIN profiles tp ON e.object_type = 'thing'   AND tp.id = t.owner_id
+
+  LEFT JOIN comments c  ON e.object_type = 'comment' AND c.id = e.object_id
+  LEFT JOIN things ct   ON e.object_type = 'comment' AND ct.id = c.thing_id
+  LEFT JOIN profiles cp ON e.object_type = 'comment' AND cp.id = ct.owner_id
+
+  LEFT JOIN badges b    ON e.object_type = 'badge'   AND b.id = e.object_id
+
+  SET e.subject = s.name,
+    e.path = COALESCE(
+      p.name,
+      CONCAT(tp.name, '/', t.name),
+      CONCAT(cp.name, '/', ct.name, '#comment-', c.id),
+      CONCAT('/badges', b.name)
+    );
+
+
+-- Feeds read the event's path and subject from events
+ALTER TABLE feeds
+  DROP ts,
+  DROP action,
+  DROP object_type,
+  DROP object_id,
+  DROP path;
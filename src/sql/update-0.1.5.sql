@@ -0,0 +1,15 @@
+-- Counter changes waiting to be applied in batches by ApplyCounterDeltas().
+-- Applied rows are kept until ReconcileCounts() has checked the counters
+-- they touched.
+CREATE TABLE IF NOT EXISTS counter_deltas (
+  id      BIGINT NOT NULL AUTO_INCREMENT,
+  tbl     VARCHAR(16) NOT NULL,
+  row_id  INT NOT NULL,
+  col     VARCHAR(16) NOT NULL,
+  delta   INT NOT NULL,
+  applied BOOL NOT NULL DEFAULT false,
+
+  PRIMARY KEY (id),
+  INDEX (applied, id),
+  INDEX (tbl, row_id)
+);
@@ -72,8 +72,8 @@ updates = sorted(updates)
 
 
 # Latest version
-if len(updates): latest = updates[-1]
-else: latest = (0, 0, 0)
+if len(updates): latest = updates[-1][0]
+else: latest = [0, 0, 0]
 
 
 # Update
@@ -98,6 +98,10 @@ else:
             print 'Applying update', version_to_str(v)
             exec_file(path)
 
+    # Reload triggers and procedures
+    exec_file(cwd + '/triggers.sql')
+    exec_file(cwd + '/procedures.sql')
+
 
 # Update version
 if version < latest or options.reset: